@@ -35,22 +35,25 @@ class Band : public File
   friend class Vault;
 
 protected:
-    Band() {}
+    Band(Database &_db) : File(_db) {}
 
     virtual BaseItem* json2item(nlohmann::json &j);
     virtual void insert_item(BaseItem* base_item);
     virtual void update_tx(BaseItem* base_item);
+    virtual bool get_tx(const std::string &uuid, long &tx);
 
 public:
     void read();
     void create_table();
     void insert_items(std::vector<BandItem> &items);
-    void sync(std::vector<BandItem> &items);
+    bool needs_sync(const std::string &filename);
+    void sync(const std::string &filename, std::vector<BandItem> &items);
 
 private:
     std::vector<std::string> filenames;
 
     void setup_filenames();
+    static void bind_shard(sqlite3_stmt *stmt, const std::string &filename);
 };
 
 }
@@ -27,6 +27,7 @@ SOFTWARE.
 
 #include <vector>
 
+#include "keycache.h"
 #include "useritem.h"
 
 namespace OPVault {
@@ -41,6 +42,19 @@ public:
         folder = "";
         trashed = -1;
         updateState = false;
+        key_cache = nullptr;
+        vault = nullptr;
+        details_loaded = true;
+    }
+
+    BandItem(const Vault &_vault) : UserItem(_vault) {
+        fave = -1;
+        folder = "";
+        trashed = -1;
+        updateState = false;
+        key_cache = nullptr;
+        vault = nullptr;
+        details_loaded = true;
     }
 
     std::string& get_category() { return category; }
@@ -73,17 +87,20 @@ private:
              std::string _k,
              int _trashed) :
         UserItem(_created,
-                 _o,
+                 std::move(_o),
                  _tx,
                  _updated,
-                 _uuid),
-        category(_category),
-        d(_d),
+                 std::move(_uuid)),
+        category(std::move(_category)),
+        d(std::move(_d)),
         fave(_fave),
-        folder(_folder),
-        hmac(_hmac),
-        k(_k),
-        trashed(_trashed)
+        folder(std::move(_folder)),
+        hmac(std::move(_hmac)),
+        k(std::move(_k)),
+        trashed(_trashed),
+        key_cache(nullptr),
+        vault(nullptr),
+        details_loaded(true)
     {
         updateState = false;
     }
@@ -96,6 +113,15 @@ private:
     std::string k;
     int trashed;
 
+    // Item key cache of the vault the item was read from, if enabled
+    KeyCache *key_cache;
+
+    // Listed items only carry the index columns and o: d, hmac and k are
+    // read from the vault DB the first time they are needed
+    const Vault *vault;
+    bool details_loaded;
+
+    void load_details();
     std::string get_hmac_input_str();
     void verify();
     void decrypt_key(CryptoPP::SecByteBlock &key);
@@ -0,0 +1,41 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "const.h"
+
+namespace OPVault {
+
+// Base64 codec for opdata, k and hmac fields. Decoding uses an AVX2 or
+// SSSE3 kernel when the CPU supports it, with a scalar fallback that skips
+// characters outside the alphabet like CryptoPP::Base64Decoder does.
+void base64_decode(const std::string &encoded, std::string &decoded);
+void base64_encode(const byte *data, size_t length, std::string &encoded);
+void base64_encode(const std::string &data, std::string &encoded);
+
+}
@@ -30,17 +30,15 @@ SOFTWARE.
 
 namespace OPVault {
 
+struct KeyContext;
+
 class BaseItem
 {
 protected:
     BaseItem() {}
 
-    static CryptoPP::SecByteBlock derived_key;
-    static CryptoPP::SecByteBlock overview_key;
-    static CryptoPP::SecByteBlock master_key;
-
     void verify_opdata(const std::string &encoded_opdata, const CryptoPP::SecByteBlock &key);
-    void decrypt_opdata(const std::string &encoded_opdata, const CryptoPP::SecByteBlock &key, std::string &plaintext);
+    void decrypt_opdata(const std::string &encoded_opdata, const CryptoPP::SecByteBlock &key, std::string &plaintext, const KeyContext *keys = nullptr);
     void encrypt_opdata(const std::string &plaintext, const CryptoPP::SecByteBlock &iv, const CryptoPP::SecByteBlock &key, std::string &encoded_opdata);
 };
 
@@ -0,0 +1,62 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace OPVault {
+
+// uuids touched by a sync or insert, by kind of change. resolved lists the
+// items changed both locally and remotely, whichever side won the merge.
+struct ChangeSet
+{
+    std::vector<std::string> added;
+    std::vector<std::string> updated;
+    std::vector<std::string> removed;
+    std::vector<std::string> resolved;
+
+    bool empty() const {
+        return added.empty() && updated.empty() && removed.empty() && resolved.empty();
+    }
+
+    void append(const ChangeSet &other) {
+        added.insert(added.end(), other.added.begin(), other.added.end());
+        updated.insert(updated.end(), other.updated.begin(), other.updated.end());
+        removed.insert(removed.end(), other.removed.begin(), other.removed.end());
+        resolved.insert(resolved.end(), other.resolved.begin(), other.resolved.end());
+    }
+};
+
+struct Changes
+{
+    ChangeSet items;
+    ChangeSet folders;
+
+    bool empty() const { return items.empty() && folders.empty(); }
+};
+
+}
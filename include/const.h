@@ -44,6 +44,10 @@ const int NON_CIPHER_LENGTH = 64;
 const int KEY_LENGTH = 64;
 const int ENC_KEY_LENGTH = 32;
 const int MAC_KEY_LENGTH = 32;
+const int MAC_LENGTH = 32;
+
+// How long a connection waits on a locked DB before failing, in ms
+const int BUSY_TIMEOUT = 5000;
 
 const int ITEM_KEY_LENGTH = 64;
 const int ITEM_K_LENGTH = 112;
@@ -58,6 +62,29 @@ const char DBFILE[] = "opvault.db";
 const std::string SQL_TABLE_ITEMS("Items");
 const std::string SQL_TABLE_FOLDERS("Folders");
 
+const char SQL_BEGIN[] = "BEGIN;";
+const char SQL_COMMIT[] = "COMMIT;";
+const char SQL_ROLLBACK[] = "ROLLBACK;";
+const char SQL_PRAGMA_WAL[] = "PRAGMA journal_mode=WAL;";
+const char SQL_PRAGMA_SYNCHRONOUS_NORMAL[] = "PRAGMA synchronous=NORMAL;";
+
+// Local DB schema version, see Vault::upgrade_db for the migrations
+const int SCHEMA_VERSION = 3;
+
+const char SQL_CREATE_SCHEMA[] = "CREATE TABLE IF NOT EXISTS Schema (version INT NOT NULL);";
+const char SQL_SELECT_SCHEMA_VERSION[] = "SELECT max(version) from Schema";
+const char SQL_UPDATE_SCHEMA_VERSION[] = "DELETE FROM Schema; INSERT INTO Schema (version) VALUES (%d);";
+
+const char SQL_CREATE_SHARDS[] = "CREATE TABLE IF NOT EXISTS Shards (" \
+                                 "filename TEXT PRIMARY KEY NOT NULL," \
+                                 "size     INT  NOT NULL," \
+                                 "mtime    INT  NOT NULL," \
+                                 "hash     TEXT NOT NULL );";
+
+const char SQL_SELECT_SHARD[] = "SELECT size, mtime, hash from Shards WHERE filename = ?";
+const char SQL_REPLACE_SHARD[] = "INSERT OR REPLACE INTO Shards (filename, size, mtime, hash) VALUES (?, ?, ?, ?);";
+const char SQL_DELETE_SHARD[] = "DELETE FROM Shards WHERE filename = ?";
+
 const char SQL_CREATE_PROFILE[] = "CREATE TABLE Profile (" \
                                   "lastUpdatedBy TEXT NOT NULL," \
                                   "updatedAt     INT  NOT NULL," \
@@ -87,6 +114,15 @@ const char SQL_CREATE_ITEMS[] = "CREATE TABLE Items (" \
                                 "k        TEXT NOT NULL," \
                                 "trashed  INT  NOT NULL );";
 
+const char SQL_CREATE_ITEMS_INDEXES[] = "CREATE INDEX IF NOT EXISTS ItemsFolder ON Items (folder);" \
+                                        "CREATE INDEX IF NOT EXISTS ItemsCategory ON Items (category);" \
+                                        "CREATE INDEX IF NOT EXISTS ItemsTrashed ON Items (trashed);";
+
+// Partial indexes over the rows with local changes not synced yet: they are
+// kept up to date by SQLite on every insert/update of updated and tx
+const char SQL_CREATE_PENDING_INDEXES[] = "CREATE INDEX IF NOT EXISTS ItemsPending ON Items (uuid) WHERE updated > tx;" \
+                                          "CREATE INDEX IF NOT EXISTS FoldersPending ON Folders (uuid) WHERE updated > tx;";
+
 const char SQL_REPLACE_ITEM[] = "INSERT OR REPLACE INTO Items (created, o, tx, updated, uuid, category, d, fave, folder, hmac, k, trashed) " \
                                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
 
@@ -100,13 +136,27 @@ const char SQL_CREATE_FOLDERS[] = "CREATE TABLE Folders (" \
 const char SQL_REPLACE_FOLDER[] = "INSERT OR REPLACE INTO Folders (created, o, tx, updated, uuid) " \
                                   "VALUES (?, ?, ?, ?, ?);";
 
-const char SQL_UPDATE_LONG[] = "UPDATE %s SET %s = %ld WHERE uuid = '%s';";
+const char SQL_UPDATE_LONG[] = "UPDATE %s SET %s = ? WHERE uuid = ?;";
 
 const char SQL_SELECT_PROFILE[] = "SELECT * from Profile";
 const char SQL_SELECT_FOLDERS[] = "SELECT * from Folders";
 const char SQL_SELECT_ITEMS[] = "SELECT * from Items";
-const char SQL_SELECT_ITEMS_FOLDER[] = "SELECT * from Items WHERE folder = '%s'";
-const char SQL_SELECT_ITEMS_CATEGORY[] = "SELECT * from Items WHERE category = '%s'";
+const char SQL_LIST_ITEMS[] = "SELECT created, o, tx, updated, uuid, category, fave, folder, trashed from Items";
+const char SQL_SELECT_PENDING_ITEMS_SHARD[] = "SELECT * from Items WHERE updated > tx AND uuid >= ? AND uuid < ?";
+const char SQL_SELECT_PENDING_FOLDERS[] = "SELECT * from Folders WHERE updated > tx";
+const char SQL_SELECT_UUIDS_SHARD[] = "SELECT uuid from Items WHERE uuid >= ? AND uuid < ?";
+const char SQL_DELETE_ITEM[] = "DELETE FROM Items WHERE uuid = ?";
+const char SQL_SELECT_ITEM_TX[] = "SELECT tx from Items WHERE uuid = ?";
+const char SQL_SELECT_FOLDER_UUIDS[] = "SELECT uuid from Folders";
+const char SQL_DELETE_FOLDER[] = "DELETE FROM Folders WHERE uuid = ?";
+const char SQL_SELECT_FOLDER_TX[] = "SELECT tx from Folders WHERE uuid = ?";
+const char SQL_COUNT_PENDING_ITEMS_SHARD[] = "SELECT count(*) from Items WHERE updated > tx AND uuid >= ? AND uuid < ?";
+const char SQL_COUNT_PENDING_FOLDERS[] = "SELECT count(*) from Folders WHERE updated > tx";
+const char SQL_SELECT_ITEM_DETAILS[] = "SELECT d, hmac, k from Items WHERE uuid = ?";
+const char SQL_WHERE_FOLDER[] = "folder = ?";
+const char SQL_WHERE_CATEGORY[] = "category = ?";
+const char SQL_SELECT_ITEMS_FOLDER[] = "SELECT * from Items WHERE folder = ?";
+const char SQL_SELECT_ITEMS_CATEGORY[] = "SELECT * from Items WHERE category = ?";
 
 const std::unordered_map<std::string, std::string> CATEGORIES = { {"001", "Login"},
                                                                   {"002", "Credit Card"},
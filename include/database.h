@@ -0,0 +1,81 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace OPVault {
+
+// A statement gave up waiting BUSY_TIMEOUT ms for a lock held by another
+// connection. Without Options::wal readers wait on writers and may get it
+class DatabaseBusy : public std::runtime_error
+{
+public:
+    explicit DatabaseBusy(int rc) : std::runtime_error("libopvault: database busy - error code: " + std::to_string(rc)) {}
+};
+
+// SQLite connection to the local cache, owned by Vault and shared with
+// Profile, Folder and Band for the whole lifetime of the vault.
+class Database
+{
+public:
+    Database() : db(nullptr), batch_size(0), batch_count(0), transaction(false) {}
+    ~Database();
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    void open(const std::string &filename);
+    void close();
+    void exec(const char sql[]);
+    sqlite3_stmt* prepare(const char sql[]) const;
+
+    void begin(size_t _batch_size = 0);
+    void commit();
+    void rollback();
+    void row_written();
+
+    sqlite3* get() const { return db; }
+
+private:
+    sqlite3 *db;
+    // Prepared statements keyed by SQL text, finalized on close. Statements
+    // are handed out reset with no bindings; callers reset them when done.
+    mutable std::unordered_map<std::string, sqlite3_stmt*> statements;
+
+    // Bulk write transaction: with a non-zero batch size it is committed and
+    // reopened every batch_size rows
+    size_t batch_size;
+    size_t batch_count;
+    bool transaction;
+};
+
+}
@@ -0,0 +1,104 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace OPVault {
+
+// Thrown by an asynchronous operation that was cancelled
+class OperationCancelled : public std::runtime_error
+{
+public:
+    OperationCancelled() : std::runtime_error("libopvault: operation cancelled") {}
+};
+
+// Shared cancellation flag: copies refer to the same flag. Operations check
+// it before they start and between their steps (e.g. band shards in sync),
+// work already committed is kept.
+class CancelToken
+{
+public:
+    CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { *flag = true; }
+    bool cancelled() const { return *flag; }
+    void check() const {
+        if (cancelled()) {
+            throw OperationCancelled();
+        }
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// Fixed size thread pool running the asynchronous Vault operations
+class Executor
+{
+public:
+    explicit Executor(size_t workers);
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    template<typename F>
+    auto submit(F f) -> std::future<decltype(f())> {
+        typedef decltype(f()) R;
+
+        std::shared_ptr<std::packaged_task<R()>> task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> future = task->get_future();
+        post([task]() { (*task)(); });
+
+        return future;
+    }
+
+    void post(std::function<void()> job);
+
+    // Process wide executor with one worker per hardware thread
+    static Executor& shared();
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> threads;
+    bool stopping;
+
+    void run();
+};
+
+}
@@ -26,43 +26,86 @@ SOFTWARE.
 #pragma once
 
 #include <string>
+#include <functional>
+#include <ostream>
+
+#include <unordered_set>
 
 #include "json.hpp"
+#include "changes.h"
 #include "const.h"
+#include "database.h"
 #include "useritem.h"
 
 namespace OPVault {
 
+class MappedFile;
+
+// Size, modification time and content hash of a cloud file as last seen by
+// the local DB
+struct ShardState
+{
+    long size;
+    long mtime;
+    std::string hash;
+};
+
 class File
 {
 protected:
-    File() {}
+    File(Database &_db) : db(_db), workers(1), changes(nullptr), removals(false) {}
     virtual ~File();
 
-    static std::string directory;
+    std::string directory;
+    Database &db;
+    size_t workers;
+    // Where sync and inserts report the uuids they touch, if set
+    ChangeSet *changes;
+    // Delete the rows missing from a synced file, see Options::remove_missing
+    bool removals;
 
-    void read(const std::string &filename, nlohmann::json &j);
+    void read(const std::string &filename, nlohmann::json &j, const nlohmann::json::parser_callback_t cb = nullptr, ShardState *state = nullptr);
     void read(const std::string &filename);
     void read(const std::vector<std::string> &filenames);
     void write(const std::string &filename, nlohmann::json &j);
     void append(const std::string &filename, nlohmann::json &j);
-    void append(const std::string &filename, UserItem* user_item);
-    void sync(const std::string filename, std::unordered_map<std::string, UserItem*> &local_map);
-    void sync(const std::vector<std::string> &filenames, std::unordered_map<std::string, UserItem*> &local_map);
+    // Merges the shard with local_map and writes it back at most once,
+    // together with the local items not found in it. remote_uuids gets the
+    // uuids found in the shard as read
+    void sync(const std::string filename, std::unordered_map<std::string, UserItem*> &local_map, std::unordered_set<std::string> *remote_uuids = nullptr);
+
+    bool shard_changed(const std::string &filename);
+    bool count_pending(sqlite3_stmt *stmt);
+    bool select_tx(sqlite3_stmt *stmt, const std::string &uuid, long &tx);
+    void remove_missing(sqlite3_stmt *stmt, const char delete_sql[], const std::unordered_set<std::string> &keep);
+    void save_shard(const std::string &filename, const ShardState &state);
+    void save_shard(const std::string &filename);
 
     void sql_exec(const char sql[]);
     void sql_update_long(const std::string &table, const std::string &col, const std::string &uuid, long val);
 
+    // json2item decodes j in a single pass and may move values out of it
     void insert_json(nlohmann::json &j);
     virtual BaseItem* json2item(nlohmann::json &j) = 0;
     virtual void insert_item(BaseItem* base_item) = 0;
     virtual void update_tx(BaseItem* base_item) = 0;
+    virtual bool get_tx(const std::string &uuid, long &tx) = 0;
+
+    static void get_long(nlohmann::json &value, long &l);
+    static void get_string(nlohmann::json &value, std::string &str);
 
 public:
     void set_directory(const std::string &d) { directory = d; }
+    void set_workers(size_t w) { workers = w; }
+    void set_changes(ChangeSet *c) { changes = c; }
+    void set_removals(bool r) { removals = r; }
 
 private:
     std::string get_prefix(const std::string &filename);
+    static void get_state(const MappedFile &file, ShardState &state);
+    static bool locate_tail(const MappedFile &file, size_t &tail, bool &empty);
+    void replace(const std::string &filename, const std::function<void(std::ostream &os)> &writer);
+    void read_parallel(const std::vector<std::string> &filenames);
 };
 
 }
@@ -35,16 +35,18 @@ class Folder : public File
   friend class Vault;
 
 protected:
-    Folder() {}
+    Folder(Database &_db) : File(_db) {}
 
     virtual BaseItem* json2item(nlohmann::json &j);
     virtual void insert_item(BaseItem* base_item);
     virtual void update_tx(BaseItem* base_item);
+    virtual bool get_tx(const std::string &uuid, long &tx);
 
 public:
     void read();
     void create_table();
     void insert_folders(std::vector<FolderItem> &folders);
+    bool needs_sync();
     void sync(std::vector<FolderItem> &folders);
 };
 
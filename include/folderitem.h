@@ -34,6 +34,7 @@ class FolderItem : public UserItem {
     friend class Folder;
 public:
     FolderItem() {}
+    FolderItem(const Vault &vault) : UserItem(vault) {}
 
 protected:
     virtual void to_json(nlohmann::json &j);
@@ -45,10 +46,10 @@ private:
                long _updated,
                std::string _uuid) :
         UserItem(_created,
-                 _o,
+                 std::move(_o),
                  _tx,
                  _updated,
-                 _uuid)
+                 std::move(_uuid))
     {}
 };
 
@@ -0,0 +1,107 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "banditem.h"
+
+struct sqlite3_stmt;
+
+namespace OPVault {
+
+class Vault;
+class Database;
+
+// Range over the Items table backed by a live SQLite cursor: rows are read
+// one at a time while iterating, and stopping early skips the rest.
+//
+//   for (auto &item : vault.items().where_folder(folder)) { ... }
+//
+// The range must not outlive the Vault it was obtained from.
+class ItemQuery
+{
+    friend class Vault;
+
+    class Cursor
+    {
+    public:
+        Cursor(const Vault &_vault, std::shared_ptr<Database> _connection, sqlite3_stmt *_stmt) : vault(_vault), connection(_connection), stmt(_stmt) {}
+        ~Cursor();
+
+        bool step();
+
+        BandItem item;
+
+    private:
+        const Vault &vault;
+        // Kept out of the reader pool until the statement is finalized
+        std::shared_ptr<Database> connection;
+        sqlite3_stmt *stmt;
+    };
+
+public:
+    class iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef BandItem value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef BandItem* pointer;
+        typedef BandItem& reference;
+
+        iterator() {}
+        explicit iterator(std::shared_ptr<Cursor> _cursor) : cursor(_cursor) {}
+
+        BandItem& operator*() const { return cursor->item; }
+        BandItem* operator->() const { return &cursor->item; }
+        iterator& operator++();
+        bool operator==(const iterator &other) const { return cursor == other.cursor; }
+        bool operator!=(const iterator &other) const { return cursor != other.cursor; }
+
+    private:
+        std::shared_ptr<Cursor> cursor;
+    };
+
+    ItemQuery where_folder(const std::string &_folder) const;
+    ItemQuery where_category(const std::string &_category) const;
+
+    iterator begin() const;
+    iterator end() const { return iterator(); }
+
+private:
+    explicit ItemQuery(const Vault &_vault) : vault(_vault), by_folder(false), by_category(false) {}
+
+    const Vault &vault;
+    bool by_folder;
+    std::string folder;
+    bool by_category;
+    std::string category;
+};
+
+}
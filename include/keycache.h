@@ -0,0 +1,59 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cryptopp/secblock.h>
+
+namespace OPVault {
+
+// Bounded LRU cache of unwrapped item keys, keyed by item uuid and its
+// encrypted key k. Keys live in SecByteBlocks and are wiped on eviction.
+class KeyCache
+{
+public:
+    explicit KeyCache(size_t _capacity) : capacity(_capacity) {}
+
+    bool get(const std::string &uuid, const std::string &k, CryptoPP::SecByteBlock &key);
+    void put(const std::string &uuid, const std::string &k, const CryptoPP::SecByteBlock &key);
+    void clear();
+
+private:
+    struct Entry {
+        std::string id;
+        CryptoPP::SecByteBlock key;
+    };
+
+    size_t capacity;
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::mutex mutex;
+};
+
+}
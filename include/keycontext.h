@@ -0,0 +1,64 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cryptopp/secblock.h>
+
+#include "const.h"
+
+namespace OPVault {
+
+class OpdataDecryptor;
+
+// Key material of one unlocked profile. Each Vault owns one and its items
+// point to it, so several vaults can be unlocked at once.
+struct KeyContext
+{
+    KeyContext();
+    ~KeyContext();
+
+    KeyContext(const KeyContext&) = delete;
+    KeyContext& operator=(const KeyContext&) = delete;
+
+    CryptoPP::SecByteBlock derived_key;
+    CryptoPP::SecByteBlock overview_key;
+    CryptoPP::SecByteBlock master_key;
+
+    // Decrypts with a decryptor taken from the pool for the call: each
+    // thread decrypting at once gets its own, re-keyed only when the key
+    // changes. The key schedules they hold are wiped with the context
+    void decrypt_opdata(const std::string &encoded_opdata, const CryptoPP::SecByteBlock &key, std::string &plaintext) const;
+
+private:
+    mutable std::mutex decryptors_mutex;
+    mutable std::vector<std::unique_ptr<OpdataDecryptor>> decryptors;
+};
+
+}
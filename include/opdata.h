@@ -0,0 +1,61 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <cryptopp/aes.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/modes.h>
+#include <cryptopp/sha.h>
+
+namespace OPVault {
+
+// Opdata decryption with the HMAC and AES objects keyed once, meant to be
+// reused across many values sharing the same key (e.g. all overviews).
+// set_key re-keys it only when the key differs, keeping the buffers, see
+// KeyContext::decrypt_opdata.
+// Not thread safe: use one instance per thread.
+class OpdataDecryptor
+{
+public:
+    OpdataDecryptor() {}
+    explicit OpdataDecryptor(const CryptoPP::SecByteBlock &key);
+
+    void set_key(const CryptoPP::SecByteBlock &key);
+
+    void verify(const std::string &encoded_opdata);
+    void decrypt(const std::string &encoded_opdata, std::string &plaintext);
+
+private:
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac;
+    CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decryption;
+    // Key the objects above were set up with
+    CryptoPP::SecByteBlock current_key;
+    // Decoded opdata, reused across calls. Only ever holds ciphertext.
+    std::string opdata;
+};
+
+}
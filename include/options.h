@@ -0,0 +1,80 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+namespace OPVault {
+
+// Tuning knobs for opening a Vault. The defaults use write-ahead logging so
+// queries from other threads don't wait on a sync, with full fsync and the
+// whole import in one transaction.
+struct Options
+{
+    // Use write-ahead logging for the local DB. With a rollback journal
+    // readers wait for a write in progress and fail with DatabaseBusy after
+    // BUSY_TIMEOUT ms
+    bool wal = true;
+    // Relax fsync to PRAGMA synchronous=NORMAL
+    bool synchronous_normal = false;
+    // Rows per transaction while importing cloud data, 0 means one transaction
+    size_t import_batch_size = 0;
+    // Threads reading and parsing band files on import, 1 reads them in turn.
+    // Sequential reads stream items one at a time, parallel reads keep each
+    // parsed shard in memory until it is written
+    size_t ingest_workers = 1;
+    // Unwrapped item keys kept in memory for decrypt_data/set_data, 0 disables
+    // the cache. Items read from the vault refer to it and must not outlive it
+    size_t key_cache_size = 0;
+    // Idle read connections kept open for the query methods. A thread takes
+    // one for the length of a query; extra connections opened under load are
+    // closed when they are given back
+    size_t reader_connections = 4;
+    // Return from the Vault constructor as soon as the keys are derived and
+    // the local DB is readable, and sync with the cloud files on a
+    // background thread. Vault::get_sync_future tells when it is done. A new
+    // local DB is still imported before returning. Destroying the Vault
+    // cancels the sync at the next shard, failing it with OperationCancelled
+    bool background_sync = false;
+    // Called on the sync thread when a background sync ends, with the vault
+    // generation and the error it failed with, if any. It must not destroy
+    // the Vault, whose destructor joins that thread
+    std::function<void(unsigned long generation, std::exception_ptr error)> sync_callback;
+    // Watch cloud_data_dir with inotify and sync the files changed there,
+    // see Vault::subscribe
+    bool watch = false;
+    // Quiet time after the last change before syncing, in ms
+    int watch_debounce = 200;
+    // Delete the local items and folders that a synced cloud file no longer
+    // lists (and report them as removed). Off by default: a stale copy of a
+    // file put back by a sync tool would delete them locally too. An empty
+    // or missing file never removes anything
+    bool remove_missing = false;
+};
+
+}
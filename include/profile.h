@@ -34,12 +34,13 @@ namespace OPVault {
 class Profile : public File
 {
 public:
-    Profile() {}
+    Profile(Database &_db) : File(_db) {}
 
 protected:
     virtual BaseItem* json2item(nlohmann::json &j);
     virtual void insert_item(BaseItem* base_item);
     virtual void update_tx(BaseItem* base_item);
+    virtual bool get_tx(const std::string &uuid, long &tx);
 
 public:
     void read();
@@ -26,6 +26,7 @@ SOFTWARE.
 #pragma once
 
 #include "baseitem.h"
+#include "keycontext.h"
 
 namespace OPVault {
 
@@ -37,9 +38,9 @@ class ProfileItem : public BaseItem
 public:
     ProfileItem() {}
 
-    void derive_keys(const std::string &master_password);
-    void get_master_key();
-    void get_overview_key();
+    void derive_keys(const std::string &master_password, KeyContext &keys);
+    void get_master_key(KeyContext &keys);
+    void get_overview_key(KeyContext &keys);
 
 private:
     ProfileItem(std::string _lastUpdatedBy,
@@ -52,15 +53,15 @@ private:
                 std::string _uuid,
                 std::string _overviewKey,
                 long _createdAt) :
-        lastUpdatedBy(_lastUpdatedBy),
+        lastUpdatedBy(std::move(_lastUpdatedBy)),
         updatedAt(_updatedAt),
-        profileName(_profileName),
-        salt(_salt),
-        passwordHint(_passwordHint),
-        masterKey(_masterKey),
+        profileName(std::move(_profileName)),
+        salt(std::move(_salt)),
+        passwordHint(std::move(_passwordHint)),
+        masterKey(std::move(_masterKey)),
         iterations(_iterations),
-        uuid(_uuid),
-        overviewKey(_overviewKey),
+        uuid(std::move(_uuid)),
+        overviewKey(std::move(_overviewKey)),
         createdAt(_createdAt)
     {}
 
@@ -75,7 +76,7 @@ private:
     std::string overviewKey;
     long createdAt;
 
-    void get_profile_key(const std::string &encoded_key_opdata, CryptoPP::SecByteBlock &profile_key);
+    void get_profile_key(const std::string &encoded_key_opdata, const KeyContext &keys, CryptoPP::SecByteBlock &profile_key);
 };
 
 }
@@ -28,27 +28,35 @@ SOFTWARE.
 #include "json.hpp"
 
 #include "baseitem.h"
+#include "keycontext.h"
 
 namespace OPVault {
 
+class Vault;
+
 class UserItem : public BaseItem {
     friend class File;
 
 protected:
     UserItem() {
         tx = 0;
+        keys = nullptr;
     }
 
+    // New items are bound to the keys of the vault they will be stored in
+    UserItem(const Vault &vault);
+
     UserItem(long _created,
              std::string _o,
              long _tx,
              long _updated,
              std::string _uuid) :
         created(_created),
-        o(_o),
+        o(std::move(_o)),
         tx(_tx),
         updated(_updated),
-        uuid(_uuid)
+        uuid(std::move(_uuid)),
+        keys(nullptr)
     {}
 
     virtual ~UserItem() {}
@@ -56,6 +64,7 @@ protected:
     virtual void init();
     void setup_update();
     virtual void to_json(nlohmann::json &j) = 0;
+    const KeyContext& get_keys() const;
 
 public:
     std::string& get_overview() { return o; }
@@ -73,6 +82,9 @@ protected:
     std::string uuid;
 
     bool updateState;
+
+    // Keys of the vault the item belongs to
+    const KeyContext *keys;
 };
 
 }
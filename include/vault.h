@@ -26,34 +26,187 @@ SOFTWARE.
 #pragma once
 
 #include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
+#include "options.h"
+#include "executor.h"
+#include "watcher.h"
 #include "profile.h"
 #include "folder.h"
 #include "band.h"
+#include "itemquery.h"
 
 namespace OPVault {
 
+// Threading: the query methods (get_folders, get_items*, list_items,
+// items(), decrypt_overviews) and decrypt_overview/decrypt_data on the
+// returned items may be called from any number of threads at once. Each
+// query reads through a connection to the local DB taken from a small pool
+// for its duration, see Options::reader_connections. insert_items,
+// insert_folders and sync are serialized on the one writer connection; with
+// Options::wal (the default) readers keep reading the last committed data
+// while a write is in progress instead of waiting for it, without it they
+// may fail with DatabaseBusy. An item object itself must not be shared
+// between threads without external locking.
+//
+// The *_async variants run the same operations on the shared Executor and
+// take an optional CancelToken; a cancelled operation fails its future with
+// OperationCancelled. sync_async checks it between shards and
+// decrypt_overviews_async between chunks of items; the other operations
+// only check it before they start and run to completion once started. The Vault waits for its pending operations when it is
+// destroyed.
 class Vault
 {
 public:
-    Vault(const std::string &cloud_data_dir, const std::string &local_data_dir, const std::string &master_password);
+    // Called with the vault generation and the cloud files that were synced
+    typedef std::function<void(unsigned long generation, const std::vector<std::string> &filenames)> FilesCallback;
+    // Called with the vault generation and the items and folders changed
+    typedef std::function<void(unsigned long generation, const Changes &changes)> ChangesCallback;
 
 private:
+    friend class ItemQuery;
+    friend class UserItem;
+    friend class BandItem;
+
+public:
+    Vault(const std::string &cloud_data_dir, const std::string &local_data_dir, const std::string &master_password, const Options &_options = Options());
+    ~Vault();
+
+private:
+    Options options;
+    Database db;
+    mutable KeyCache key_cache;
+    KeyContext keys;
+    std::string dbfile;
+    std::string cloud_dir;
+
+    std::mutex write_mutex;
+    // Idle read connections, at most options.reader_connections
+    mutable std::mutex readers_mutex;
+    mutable std::vector<std::unique_ptr<Database>> readers;
     ProfileItem profile;
 
+    // Incremented every time a sync completes
+    std::atomic<unsigned long> generation;
+    // Set when the watcher sees a newer profile.js
+    std::atomic<bool> reopen_needed;
+    std::shared_future<void> sync_future;
+    std::thread sync_thread;
+    // Set when the Vault is destroyed: stops the background sync between
+    // shards and the watcher sync between files
+    CancelToken sync_cancel;
+
+    // Asynchronous operations not completed yet
+    mutable std::mutex async_mutex;
+    mutable std::condition_variable async_done;
+    mutable size_t async_pending;
+
+    std::mutex subscribers_mutex;
+    std::map<size_t, FilesCallback> subscribers;
+    std::map<size_t, ChangesCallback> observers;
+    size_t subscriber_id;
+    std::unique_ptr<Watcher> watcher;
+
+    void open_db();
+    void start_sync();
+    void start_watch();
+    std::shared_ptr<Database> reader() const;
+    void release_reader(Database *connection) const;
+    void upgrade_db();
     void get_profile();
     void setup_profile(const std::string &master_password);
-    void get_items_query(const char query[], std::vector<BandItem> &items) const;
+    void get_folders_query(sqlite3_stmt *stmt, std::vector<FolderItem> &folders) const;
+    void get_items_query(sqlite3_stmt *stmt, std::vector<BandItem> &items) const;
+    void read_item(sqlite3_stmt *stmt, BandItem &item) const;
     void create_db(const std::string &cloud_data_dir);
+    void sync(const CancelToken *cancel);
+    void decrypt_overviews(const std::vector<BandItem> &items, std::vector<std::string> &overviews, size_t workers, const CancelToken *cancel) const;
+    bool sync_folders(ChangeSet &changes);
+    bool sync_shard(Band &band, const std::string &filename, ChangeSet &changes);
+    void sync_files(const std::vector<std::string> &filenames);
+    void notify(const Changes &changes);
+
+    template<typename F>
+    auto run_async(F f) const -> std::future<decltype(f())> {
+        {
+            std::lock_guard<std::mutex> lock(async_mutex);
+            ++async_pending;
+        }
+
+        try {
+            return Executor::shared().submit([this, f]() mutable {
+                struct Finished {
+                    const Vault *vault;
+                    ~Finished() { vault->async_finished(); }
+                } finished = { this };
+
+                return f();
+            });
+        }
+        catch (...) {
+            // Never queued
+            async_finished();
+            throw;
+        }
+    }
+    void async_finished() const;
 
 public:
+    // Folders and items returned by these methods and their *_async
+    // variants, and the ones yielded by items(), point back at this Vault
+    // (its keys, key cache and read connections) through raw pointers: they
+    // must not be used after the Vault is destroyed. Copy out what has to
+    // outlive it.
     void get_folders(std::vector<FolderItem> &folders) const;
     void insert_folders(std::vector<FolderItem> &folders);
     void get_items(std::vector<BandItem> &items) const;
+    void list_items(std::vector<BandItem> &items) const;
+    ItemQuery items() const { return ItemQuery(*this); }
     void insert_items(std::vector<BandItem> &items);
     void get_items_folder(const std::string &folder, std::vector<BandItem> &items) const;
     void get_items_category(const std::string &category, std::vector<BandItem> &items) const;
+    void decrypt_overviews(const std::vector<BandItem> &items, std::vector<std::string> &overviews, size_t workers = 0) const;
+    // Shards that fail to sync don't stop the others; sync then throws
+    // naming them, and the generation is left as it was
     void sync();
+
+    // Completes when the background sync started on open ends, and rethrows
+    // its error. Ready at once if none was started
+    std::shared_future<void> get_sync_future() const { return sync_future; }
+    unsigned long get_generation() const { return generation; }
+    // True once the watcher saw a profile.js newer than the one the vault
+    // was opened with: the keys may have changed, and only opening the
+    // Vault again with the master password picks it up
+    bool needs_reopen() const { return reopen_needed; }
+
+    // With Options::watch, callbacks are called on the watcher thread after
+    // changed cloud files were synced. subscribe returns the id to pass to
+    // unsubscribe. profile.js is listed when it is newer than the vault
+    // profile (see needs_reopen); it bumps no generation
+    size_t subscribe(FilesCallback callback);
+    // Callbacks are called on the calling thread (or the sync/watcher
+    // thread) after every sync, insert_items or insert_folders that changed
+    // something, with the uuids involved. Same ids as subscribe.
+    // A callback must not destroy the Vault: ~Vault joins the watcher and
+    // sync threads, and would be joining the thread it runs on
+    size_t observe(ChangesCallback callback);
+    void unsubscribe(size_t id);
+
+    static std::future<std::unique_ptr<Vault>> open_async(const std::string &cloud_data_dir, const std::string &local_data_dir, const std::string &master_password, const Options &options = Options(), CancelToken cancel = CancelToken());
+    std::future<void> sync_async(CancelToken cancel = CancelToken());
+    std::future<std::vector<FolderItem>> get_folders_async(CancelToken cancel = CancelToken()) const;
+    std::future<std::vector<BandItem>> get_items_async(CancelToken cancel = CancelToken()) const;
+    std::future<std::vector<BandItem>> get_items_folder_async(const std::string &folder, CancelToken cancel = CancelToken()) const;
+    std::future<std::vector<BandItem>> get_items_category_async(const std::string &category, CancelToken cancel = CancelToken()) const;
+    std::future<std::vector<std::string>> decrypt_overviews_async(const std::vector<BandItem> &items, CancelToken cancel = CancelToken()) const;
+    std::future<std::string> decrypt_overview_async(const BandItem &item, CancelToken cancel = CancelToken()) const;
+    std::future<std::string> decrypt_data_async(const BandItem &item, CancelToken cancel = CancelToken()) const;
 };
 
 }
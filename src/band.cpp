@@ -50,103 +50,152 @@ void Band::create_table() {
 
 void Band::insert_item(BaseItem* base_item) {
     BandItem* item = static_cast<BandItem*>(base_item);
-    sqlite3 *db;
-    int rc;
-
-    rc = sqlite3_open(DBFILE, &db);
-
-    if(rc){
-        std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
-    }
-
-    sqlite3_stmt *stmt;
-    if ((rc = sqlite3_prepare_v2(db, SQL_REPLACE_ITEM, -1, &stmt, nullptr) != SQLITE_OK)) {
+    sqlite3_stmt *stmt = db.prepare(SQL_REPLACE_ITEM);
+
+    sqlite3_bind_int64(stmt, 1, item->created);
+    sqlite3_bind_text(stmt, 2, item->o.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, item->tx);
+    sqlite3_bind_int64(stmt, 4, item->updated);
+    sqlite3_bind_text(stmt, 5, item->uuid.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, item->category.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, item->d.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 8, item->fave);
+    sqlite3_bind_text(stmt, 9, item->folder.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 10, item->hmac.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 11, item->k.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 12, item->trashed);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         std::ostringstream os;
-        os << "libopvault: SQL prepare error - error code: " << rc;
-        sqlite3_close(db);
+        os << "libopvault: error replacing data in Items table - error code: " << rc;
         throw std::runtime_error(os.str());
-    } else {
-        sqlite3_bind_int64(stmt, 1, item->created);
-        sqlite3_bind_text(stmt, 2, item->o.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 3, item->tx);
-        sqlite3_bind_int64(stmt, 4, item->updated);
-        sqlite3_bind_text(stmt, 5, item->uuid.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 6, item->category.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 7, item->d.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 8, item->fave);
-        sqlite3_bind_text(stmt, 9, item->folder.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 10, item->hmac.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 11, item->k.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 12, item->trashed);
-
-        int rc = sqlite3_step(stmt);
-        if (rc != SQLITE_DONE) {
-            std::ostringstream os;
-            os << "libopvault: error replacing data in Folders table - error code: " << rc;
-            sqlite3_close(db);
-            throw std::runtime_error(os.str());
-        }
-
-        sqlite3_finalize(stmt);
     }
-
-    sqlite3_close(db);
 }
 
 void Band::insert_items(std::vector<BandItem> &items) {
     for(auto &item : items) {
+        item.load_details();
         if (item.updateState) {
+            long tx;
+            bool exists = get_tx(item.uuid, tx);
             item.generate_hmac();
             insert_item(&item);
             item.updateState = false;
+            if (changes) {
+                (exists ? changes->updated : changes->added).push_back(item.uuid);
+            }
         } else {
             insert_item(&item);
         }
     }
 }
 
-void Band::sync(std::vector<BandItem> &items) {
+bool Band::get_tx(const std::string &uuid, long &tx) {
+    return select_tx(db.prepare(SQL_SELECT_ITEM_TX), uuid, tx);
+}
+
+bool Band::needs_sync(const std::string &filename) {
+    if (shard_changed(filename)) {
+        return true;
+    }
+
+    // Unchanged on disk, check for local changes not written back yet
+    sqlite3_stmt *stmt = db.prepare(SQL_COUNT_PENDING_ITEMS_SHARD);
+    bind_shard(stmt, filename);
+
+    return count_pending(stmt);
+}
+
+void Band::sync(const std::string &filename, std::vector<BandItem> &items) {
     std::unordered_map<std::string, UserItem*> local_map;
+    std::unordered_set<std::string> keep;
 
     for (auto &item : items) {
         // Create a map with key uuid for local items
         local_map.insert({item.uuid, &item});
     }
 
-    setup_filenames();
-
     try {
-        File::sync(filenames, local_map);
+        File::sync(filename, local_map, &keep);
     } catch (...) {
         throw;
     }
 
-    // New local items: sync new elements still in the map
-    if (!local_map.empty()) {
-        for (auto const &item : local_map) {
-            DBGMSG("new local item");
-            append(std::string("band_") + item.second->get_uuid()[0] + std::string(".js"), item.second);
+    // Items no longer in the shard were deleted remotely, local items were
+    // just written to it. An empty or missing shard is not taken as a
+    // deletion of all its items
+    if (removals && !keep.empty()) {
+        for (auto const &item : items) {
+            keep.insert(item.uuid);
         }
+        sqlite3_stmt *stmt = db.prepare(SQL_SELECT_UUIDS_SHARD);
+        bind_shard(stmt, filename);
+        remove_missing(stmt, SQL_DELETE_ITEM, keep);
     }
 }
 
+void Band::bind_shard(sqlite3_stmt *stmt, const std::string &filename) {
+    // band_X.js holds the items whose uuid starts with X
+    const char first[2] = { filename[5], '\0' };
+    const char last[2] = { static_cast<char>(filename[5] + 1), '\0' };
+
+    sqlite3_bind_text(stmt, 1, first, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, last, -1, SQLITE_TRANSIENT);
+}
+
 BaseItem* Band::json2item(nlohmann::json &j) {
-  return new BandItem(
-      j["created"].is_number_integer() ? j["created"].get<long>() : -1,
-      j["o"].is_string() ? j["o"].get<std::string>() : "",
-      j["tx"].is_number_integer() ? j["tx"].get<long>() : -1,
-      j["updated"].is_number_integer() ? j["updated"].get<long>() : -1,
-      j["uuid"].is_string() ? j["uuid"].get<std::string>() : "",
-      j["category"].is_string() ? j["category"].get<std::string>() : "",
-      j["d"].is_string() ? j["d"].get<std::string>() : "",
-      j["fave"].is_number_integer() ? j["fave"].get<long>() : -1,
-      j["folder"].is_string() ? j["folder"].get<std::string>() : "",
-      j["hmac"].is_string() ? j["hmac"].get<std::string>() : "",
-      j["k"].is_string() ? j["k"].get<std::string>() : "",
-      j["trashed"].is_boolean() ? j["trashed"].get<int>() : j["trashed"].is_string() ? std::stoi(j["trashed"].get<std::string>()) : -1);
+    long created = -1;
+    std::string o;
+    long tx = -1;
+    long updated = -1;
+    std::string uuid;
+    std::string category;
+    std::string d;
+    long fave = -1;
+    std::string folder;
+    std::string hmac;
+    std::string k;
+    int trashed = -1;
+
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        const std::string &key = it.key();
+        nlohmann::json &value = it.value();
+
+        if (key == "uuid") {
+            get_string(value, uuid);
+        } else if (key == "d") {
+            get_string(value, d);
+        } else if (key == "o") {
+            get_string(value, o);
+        } else if (key == "k") {
+            get_string(value, k);
+        } else if (key == "hmac") {
+            get_string(value, hmac);
+        } else if (key == "created") {
+            get_long(value, created);
+        } else if (key == "tx") {
+            get_long(value, tx);
+        } else if (key == "updated") {
+            get_long(value, updated);
+        } else if (key == "category") {
+            get_string(value, category);
+        } else if (key == "folder") {
+            get_string(value, folder);
+        } else if (key == "fave") {
+            get_long(value, fave);
+        } else if (key == "trashed") {
+            if (value.is_boolean()) {
+                trashed = value.get<bool>() ? 1 : 0;
+            } else if (value.is_string()) {
+                trashed = std::stoi(value.get_ref<std::string&>());
+            }
+        }
+    }
+
+    return new BandItem(created, std::move(o), tx, updated, std::move(uuid), std::move(category), std::move(d),
+                        fave, std::move(folder), std::move(hmac), std::move(k), trashed);
 }
 
 void Band::setup_filenames() {
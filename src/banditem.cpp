@@ -23,13 +23,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#include <cryptopp/base64.h>
+#include <cryptopp/filters.h>
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/osrng.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/sha.h>
+#include <sqlite3.h>
 
+#include "base64.h"
 #include "dbg.h"
 #include "const.h"
 #include "vault.h"
@@ -41,11 +43,15 @@ using namespace CryptoPP;
 namespace OPVault {
 
 void BandItem::decrypt_key(SecByteBlock &key) {
+    if (key_cache && key_cache->get(uuid, k, key)) {
+        return;
+    }
+
     std::string encrypted_key;
-    StringSource(k, true, new Base64Decoder(new StringSink(encrypted_key)));
+    base64_decode(k, encrypted_key);
 
     // Verify
-    HMAC<SHA256> hmac(master_key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
+    HMAC<SHA256> hmac(get_keys().master_key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
     const int flags = HashVerificationFilter::THROW_EXCEPTION | HashVerificationFilter::HASH_AT_END;
 
     try {
@@ -60,24 +66,60 @@ void BandItem::decrypt_key(SecByteBlock &key) {
 
     std::string ciphertext = std::string(encrypted_key.data()+AES::BLOCKSIZE, ITEM_KEY_LENGTH);
 
-    CBC_Mode<AES>::Decryption decryption(master_key, ENC_KEY_LENGTH, iv);
+    CBC_Mode<AES>::Decryption decryption(get_keys().master_key, ENC_KEY_LENGTH, iv);
 
     key = SecByteBlock(ITEM_KEY_LENGTH);
     StringSource(ciphertext, true, new StreamTransformationFilter(decryption, new ArraySink(key.data(), key.size()), StreamTransformationFilter::NO_PADDING));
+
+    if (key_cache) {
+        key_cache->put(uuid, k, key);
+    }
+}
+
+void BandItem::load_details() {
+    if (details_loaded || !vault) {
+        return;
+    }
+
+    std::shared_ptr<Database> connection = vault->reader();
+    sqlite3_stmt *stmt = connection->prepare(SQL_SELECT_ITEM_DETAILS);
+    sqlite3_bind_text(stmt, 1, uuid.c_str(), -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_BUSY) {
+        sqlite3_reset(stmt);
+        throw DatabaseBusy(rc);
+    }
+    if (rc != SQLITE_ROW) {
+        std::ostringstream os;
+        os << "libopvault: item " << uuid << " not present in DB - error code: " << rc;
+        sqlite3_reset(stmt);
+        throw std::runtime_error(os.str());
+    }
+    d = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    hmac = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    k = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    sqlite3_reset(stmt);
+
+    details_loaded = true;
 }
 
 void BandItem::decrypt_data(std::string& data) {
+    load_details();
+
     if (!d.empty()) {
         verify();
         SecByteBlock item_key;
 
         decrypt_key(item_key);
 
-        decrypt_opdata(d, item_key, data);
+        decrypt_opdata(d, item_key, data, &get_keys());
     }
 }
 
 void BandItem::to_json(nlohmann::json &j) {
+    load_details();
+
     nlohmann::json j_item;
     j_item["created"]  = created;
     j_item["o"]        = o;
@@ -117,9 +159,9 @@ std::string BandItem::get_hmac_input_str() {
 
 void BandItem::verify() {
     std::string input;
-    StringSource(hmac, true, new Base64Decoder(new StringSink(input)));
+    base64_decode(hmac, input);
 
-    HMAC<SHA256> _hmac(overview_key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
+    HMAC<SHA256> _hmac(get_keys().overview_key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
 
     input = get_hmac_input_str() + input;
 
@@ -142,28 +184,30 @@ void BandItem::init() {
     prng.GenerateBlock(iv, iv.size());
 
     // Encryption
-    CBC_Mode<AES>::Encryption encryption(master_key, ENC_KEY_LENGTH, iv);
+    CBC_Mode<AES>::Encryption encryption(get_keys().master_key, ENC_KEY_LENGTH, iv);
 
     ArraySource(plain_key.data(), plain_key.size(), true, new StreamTransformationFilter(encryption, new StringSink(encrypted_key), StreamTransformationFilter::NO_PADDING));
 
     // HMAC
     std::string mac;
 
-    HMAC<SHA256> _hmac(master_key+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
+    HMAC<SHA256> _hmac(get_keys().master_key+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
 
     StringSource(std::string(reinterpret_cast<const char *> (iv.data()), AES::BLOCKSIZE) + encrypted_key, true, new HashFilter(_hmac, new StringSink(mac)));
 
     // Base64 encoding
-    StringSource(std::string(reinterpret_cast<const char *> (iv.data()), AES::BLOCKSIZE) + encrypted_key + mac, true, new Base64Encoder(new StringSink(k), false));
+    base64_encode(std::string(reinterpret_cast<const char *> (iv.data()), AES::BLOCKSIZE) + encrypted_key + mac, k);
 }
 
 void BandItem::set_category(const std::string &_category) {
+    load_details();
     setup_update();
 
     category = _category;
 }
 
 void BandItem::set_data(const std::string &_d) {
+    load_details();
     setup_update();
 
     SecByteBlock item_key;
@@ -184,18 +228,21 @@ void BandItem::set_data(const std::string &_d) {
 }
 
 void BandItem::set_fave(const long _fave) {
+    load_details();
     setup_update();
 
     fave = _fave;
 }
 
 void BandItem::set_folder(const std::string &_folder) {
+    load_details();
     setup_update();
 
     folder = _folder;
 }
 
 void BandItem::set_trashed(const int _trashed) {
+    load_details();
     setup_update();
 
     trashed = _trashed;
@@ -206,7 +253,7 @@ void BandItem::generate_hmac() {
     std::string mac;
     std::string input = get_hmac_input_str();
 
-    HMAC<SHA256> _hmac(overview_key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
+    HMAC<SHA256> _hmac(get_keys().overview_key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
 
     StringSource(input, true, new HashFilter(_hmac, new StringSink(mac)));
 
@@ -214,7 +261,7 @@ void BandItem::generate_hmac() {
     if (!hmac.empty()) {
         hmac.clear();
     }
-    StringSource(mac, true, new Base64Encoder(new StringSink(hmac), false));
+    base64_encode(mac, hmac);
 }
 
 }
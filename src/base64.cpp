@@ -0,0 +1,243 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OPVAULT_BASE64_X86
+#include <immintrin.h>
+#endif
+
+#include "base64.h"
+
+namespace OPVault {
+
+static const char ENCODE_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Maps an input char to its 6 bit value, 0xFF outside the alphabet
+struct DecodeTable
+{
+    unsigned char values[256];
+
+    DecodeTable() {
+        memset(values, 0xFF, sizeof(values));
+        for (unsigned char i = 0; i < 64; ++i) {
+            values[static_cast<unsigned char>(ENCODE_TABLE[i])] = i;
+        }
+    }
+};
+
+static const DecodeTable DECODE_TABLE;
+
+// Decode kernels consume whole blocks of valid input and return the number
+// of chars consumed; the output gets 3 bytes per 4 chars consumed
+typedef size_t (*decode_kernel_t)(const char *in, size_t length, byte *out);
+
+static size_t decode_scalar_blocks(const char *, size_t, byte *) {
+    return 0;
+}
+
+#ifdef OPVAULT_BASE64_X86
+
+// Vectorised lookup after W. Mula and D. Lemire, "Faster Base64 Encoding and
+// Decoding Using AVX2 Instructions"
+__attribute__((target("ssse3")))
+static size_t decode_ssse3_blocks(const char *in, size_t length, byte *out) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                           0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2F = _mm_set1_epi8(0x2F);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t consumed = 0;
+
+    // Each block writes 16 bytes of which 12 are output: keep a block of slack
+    while (length - consumed >= 32) {
+        __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i *> (in + consumed));
+
+        const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2F);
+        const __m128i lo_nibbles = _mm_and_si128(str, mask_2F);
+        const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF) {
+            break;
+        }
+
+        const __m128i eq_2F = _mm_cmpeq_epi8(str, mask_2F);
+        const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2F, hi_nibbles));
+        str = _mm_add_epi8(str, roll);
+
+        str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+        str = _mm_shuffle_epi8(str, pack);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *> (out), str);
+        out += 12;
+        consumed += 16;
+    }
+
+    return consumed;
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2_blocks(const char *in, size_t length, byte *out) {
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                              0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71,
+                                              0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2F = _mm256_set1_epi8(0x2F);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+    size_t consumed = 0;
+
+    // Each block writes 32 bytes of which 24 are output: keep a block of slack
+    while (length - consumed >= 64) {
+        __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (in + consumed));
+
+        const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2F);
+        const __m256i lo_nibbles = _mm256_and_si256(str, mask_2F);
+        const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+
+        const __m256i eq_2F = _mm256_cmpeq_epi8(str, mask_2F);
+        const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2F, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+        str = _mm256_shuffle_epi8(str, pack);
+        str = _mm256_permutevar8x32_epi32(str, compact);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *> (out), str);
+        out += 24;
+        consumed += 32;
+    }
+
+    // Finish what is left of the slack with the narrower kernel
+    return consumed + decode_ssse3_blocks(in + consumed, length - consumed, out);
+}
+
+#endif
+
+static decode_kernel_t select_decode_kernel() {
+#ifdef OPVAULT_BASE64_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return decode_avx2_blocks;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return decode_ssse3_blocks;
+    }
+#endif
+    return decode_scalar_blocks;
+}
+
+void base64_decode(const std::string &encoded, std::string &decoded) {
+    static const decode_kernel_t decode_blocks = select_decode_kernel();
+
+    const char *in = encoded.data();
+    size_t length = encoded.length();
+
+    decoded.resize(length / 4 * 3 + 3);
+    byte *out = reinterpret_cast<byte *> (&decoded[0]);
+
+    size_t consumed = decode_blocks(in, length, out);
+    out += consumed / 4 * 3;
+
+    // Scalar tail: padding, leftovers and anything the kernel rejected.
+    // Chars outside the alphabet are skipped, decoding stops at '='
+    unsigned int bits = 0;
+    int count = 0;
+    for (size_t i = consumed; i < length && in[i] != '='; ++i) {
+        unsigned char value = DECODE_TABLE.values[static_cast<unsigned char>(in[i])];
+        if (value == 0xFF) {
+            continue;
+        }
+        bits = (bits << 6) | value;
+        if (++count == 4) {
+            *out++ = static_cast<byte>(bits >> 16);
+            *out++ = static_cast<byte>(bits >> 8);
+            *out++ = static_cast<byte>(bits);
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 2) {
+        *out++ = static_cast<byte>(bits >> 4);
+    } else if (count == 3) {
+        *out++ = static_cast<byte>(bits >> 10);
+        *out++ = static_cast<byte>(bits >> 2);
+    }
+
+    decoded.resize(out - reinterpret_cast<byte *> (&decoded[0]));
+}
+
+void base64_encode(const byte *data, size_t length, std::string &encoded) {
+    encoded.resize((length + 2) / 3 * 4);
+    char *out = &encoded[0];
+
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        unsigned int bits = (data[i] << 16) | (data[i+1] << 8) | data[i+2];
+        *out++ = ENCODE_TABLE[(bits >> 18) & 0x3F];
+        *out++ = ENCODE_TABLE[(bits >> 12) & 0x3F];
+        *out++ = ENCODE_TABLE[(bits >> 6) & 0x3F];
+        *out++ = ENCODE_TABLE[bits & 0x3F];
+    }
+
+    if (i + 1 == length) {
+        unsigned int bits = data[i] << 16;
+        *out++ = ENCODE_TABLE[(bits >> 18) & 0x3F];
+        *out++ = ENCODE_TABLE[(bits >> 12) & 0x3F];
+        *out++ = '=';
+        *out++ = '=';
+    } else if (i + 2 == length) {
+        unsigned int bits = (data[i] << 16) | (data[i+1] << 8);
+        *out++ = ENCODE_TABLE[(bits >> 18) & 0x3F];
+        *out++ = ENCODE_TABLE[(bits >> 12) & 0x3F];
+        *out++ = ENCODE_TABLE[(bits >> 6) & 0x3F];
+        *out++ = '=';
+    }
+}
+
+void base64_encode(const std::string &data, std::string &encoded) {
+    base64_encode(reinterpret_cast<const byte *> (data.data()), data.length(), encoded);
+}
+
+}
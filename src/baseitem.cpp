@@ -23,15 +23,18 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#include <cryptopp/base64.h>
+#include <cryptopp/filters.h>
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/osrng.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/sha.h>
 
+#include "base64.h"
 #include "const.h"
 #include "dbg.h"
+#include "keycontext.h"
+#include "opdata.h"
 
 #include "baseitem.h"
 
@@ -39,59 +42,21 @@ using namespace CryptoPP;
 
 namespace OPVault {
 
-SecByteBlock BaseItem::derived_key(KEY_LENGTH);
-SecByteBlock BaseItem::master_key(KEY_LENGTH);
-SecByteBlock BaseItem::overview_key(KEY_LENGTH);
-
 void BaseItem::verify_opdata(const std::string &encoded_opdata, const SecByteBlock &key) {
-    std::string opdata;
-    StringSource(encoded_opdata, true, new Base64Decoder(new StringSink(opdata)));
-
-    HMAC<SHA256> hmac(key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
-    const int flags = HashVerificationFilter::THROW_EXCEPTION | HashVerificationFilter::HASH_AT_END;
-
-    StringSource(opdata, true, new HashVerificationFilter(hmac, nullptr, flags));
+    OpdataDecryptor decryptor(key);
+    decryptor.verify(encoded_opdata);
 }
 
-void BaseItem::decrypt_opdata(const std::string &encoded_opdata, const SecByteBlock &key, std::string &plaintext) {
-    try {
-        verify_opdata(encoded_opdata, key);
-    }
-    catch (...) {
-        throw std::invalid_argument("libopvault: failed hash check");
-    }
-
-    std::string opdata;
-    StringSource(encoded_opdata, true, new Base64Decoder(new StringSink(opdata)));
-
-    DBGVAR(opdata);
-
-    size_t ciphertext_length;
-    ciphertext_length = opdata.length() - NON_CIPHER_LENGTH;
-
-    char header[HEADER_LENGTH];
-    memcpy(header, opdata.data(), HEADER_LENGTH);
-
-    if (memcmp(header, "opdata01", HEADER_LENGTH)) {
-        throw std::invalid_argument("libopvault: invalid opdata value");
+void BaseItem::decrypt_opdata(const std::string &encoded_opdata, const SecByteBlock &key, std::string &plaintext, const KeyContext *keys) {
+    // The vault's decryptors are reused, without a vault one is keyed for
+    // the call and wiped when it returns
+    if (keys) {
+        keys->decrypt_opdata(encoded_opdata, key, plaintext);
+    } else {
+        OpdataDecryptor decryptor(key);
+        decryptor.decrypt(encoded_opdata, plaintext);
     }
 
-    size_t plaintext_length;
-    memcpy(&plaintext_length, opdata.data()+HEADER_LENGTH, LENGTH_LENGTH);
-
-    SecByteBlock iv(reinterpret_cast<const unsigned char *> (opdata.data())+START_IV, AES::BLOCKSIZE);
-
-    std::string ciphertext = std::string(opdata.data()+START_CIPHER, ciphertext_length);
-
-    CBC_Mode<AES>::Decryption decryption(key, ENC_KEY_LENGTH, iv);
-
-    if (!plaintext.empty()) {
-        plaintext.clear();
-    }
-    StringSource(ciphertext, true, new StreamTransformationFilter(decryption, new StringSink(plaintext), StreamTransformationFilter::NO_PADDING));
-
-    plaintext.erase(0, ciphertext_length-plaintext_length);
-
     DBGVAR(plaintext);
 }
 
@@ -126,7 +91,7 @@ void BaseItem::encrypt_opdata(const std::string &plaintext, const SecByteBlock &
     StringSource(opdata, true, new HashFilter(hmac, new StringSink(mac)));
 
     // Base64 encoding
-    StringSource(opdata + mac, true, new Base64Encoder(new StringSink(encoded_opdata), false));
+    base64_encode(opdata + mac, encoded_opdata);
 
     delete[] padding;
 }
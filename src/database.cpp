@@ -0,0 +1,136 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <sstream>
+#include <sqlite3.h>
+
+#include "dbg.h"
+#include "const.h"
+
+#include "database.h"
+
+namespace OPVault {
+
+Database::~Database() {
+    close();
+}
+
+void Database::open(const std::string &filename) {
+    if (db) {
+        return;
+    }
+
+    int rc = sqlite3_open(filename.c_str(), &db);
+
+    if(rc){
+        std::ostringstream os;
+        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
+        sqlite3_close(db);
+        db = nullptr;
+        throw std::runtime_error(os.str());
+    }
+
+    sqlite3_busy_timeout(db, BUSY_TIMEOUT);
+}
+
+void Database::close() {
+    if (transaction) {
+        rollback();
+    }
+
+    for (auto const &statement : statements) {
+        sqlite3_finalize(statement.second);
+    }
+    statements.clear();
+
+    if (db) {
+        sqlite3_close(db);
+        db = nullptr;
+    }
+}
+
+void Database::exec(const char sql[]) {
+    char *zErrMsg = nullptr;
+    int rc;
+
+    rc = sqlite3_exec(db, sql, nullptr, nullptr, &zErrMsg);
+
+    if(rc != SQLITE_OK){
+        std::ostringstream os;
+        os << "libopvault: SQL error: " << zErrMsg << " - error code: " << rc;
+        sqlite3_free(zErrMsg);
+        throw std::runtime_error(os.str());
+    }
+
+    sqlite3_free(zErrMsg);
+}
+
+sqlite3_stmt* Database::prepare(const char sql[]) const {
+    auto const &found = statements.find(sql);
+    if (found != statements.end()) {
+        sqlite3_reset(found->second);
+        sqlite3_clear_bindings(found->second);
+        return found->second;
+    }
+
+    sqlite3_stmt *stmt;
+    int rc;
+    if ((rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr)) != SQLITE_OK) {
+        std::ostringstream os;
+        os << "libopvault: SQL prepare error - error code: " << rc;
+        throw std::runtime_error(os.str());
+    }
+    statements.insert({sql, stmt});
+
+    return stmt;
+}
+
+void Database::begin(size_t _batch_size) {
+    exec(SQL_BEGIN);
+    transaction = true;
+    batch_size = _batch_size;
+    batch_count = 0;
+}
+
+void Database::commit() {
+    exec(SQL_COMMIT);
+    transaction = false;
+}
+
+void Database::rollback() {
+    transaction = false;
+    exec(SQL_ROLLBACK);
+}
+
+void Database::row_written() {
+    if (transaction && batch_size > 0 && ++batch_count >= batch_size) {
+        DBGMSG("commit batch");
+        exec(SQL_COMMIT);
+        exec(SQL_BEGIN);
+        batch_count = 0;
+    }
+}
+
+}
@@ -25,12 +25,25 @@ SOFTWARE.
 
 #include <fstream>
 #include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <cryptopp/base64.h>
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
+#include <cryptopp/sha.h>
 #include <sqlite3.h>
 
 #include "dbg.h"
+#include "base64.h"
+#include "mappedfile.h"
 
 #include "file.h"
 
@@ -38,39 +51,34 @@ using namespace CryptoPP;
 
 namespace OPVault {
 
-std::string File::directory;
-
 File::~File() {
 
 }
 
-void File::read(const std::string &filename, nlohmann::json &j) {
-    std::ifstream ifs(directory + "/" + filename);
-    std::string file_string;
-    std::ostringstream oss;
-    std::string line;
+void File::read(const std::string &filename, nlohmann::json &j, const nlohmann::json::parser_callback_t cb, ShardState *state) {
+    MappedFile file(directory + "/" + filename);
 
-    if (ifs.is_open()) {
-        while(getline(ifs, line)) {
-            oss << line;
-        }
+    if (state) {
+        get_state(file, *state);
     }
-    else {
-        throw std::runtime_error(std::string("libopvault: unable to read file ") + directory + "/" + filename);
+
+    // Locate the ld({ ... }); / loadFolders({ ... }); envelope in place
+    const char *first = file.begin();
+    while (first != file.end() && *first != '{') {
+        ++first;
     }
-    file_string = oss.str();
 
-    {
-        std::string::iterator it;
-        for (it=file_string.begin(); *it!='{'; ++it);
-        file_string.erase(file_string.begin(), it);
+    const char *last = file.end();
+    while (last != first && *(last-1) != '}') {
+        --last;
+    }
 
-        for (it=file_string.end(); *it!='}'; --it);
-        file_string.erase(++it, file_string.end());
+    if (first == last) {
+        throw std::runtime_error(std::string("libopvault: invalid file format ") + directory + "/" + filename);
     }
 
     try {
-        j = nlohmann::json::parse(file_string);
+        j = nlohmann::json::parse(first, last, cb);
     }
     catch (...) {
         throw;
@@ -85,20 +93,32 @@ void File::read(const std::string &filename, nlohmann::json &j) {
 
 void File::read(const std::string &filename) {
     nlohmann::json j;
+    ShardState state;
 
+    // Stream the items: each one is inserted as soon as it is parsed and
+    // then dropped, so the shard DOM is never built
     try {
-        read(filename, j);
+        read(filename, j, [this](int depth, nlohmann::json::parse_event_t event, nlohmann::json &parsed) {
+            if (depth == 1 && event == nlohmann::json::parse_event_t::object_end) {
+                insert_json(parsed);
+                return false;
+            }
+            return true;
+        }, &state);
     }
     catch (...) {
         throw;
     }
 
-    for(auto &elem : j) {
-        insert_json(elem);
-    }
+    save_shard(filename, state);
 }
 
 void File::read(const std::vector<std::string> &filenames) {
+    if (workers > 1 && filenames.size() > 1) {
+        read_parallel(filenames);
+        return;
+    }
+
     size_t exept_count = 0;
 
     for (auto const &filename : filenames) {
@@ -115,15 +135,77 @@ void File::read(const std::vector<std::string> &filenames) {
     }
 }
 
-void File::write(const std::string &filename, nlohmann::json &j) {
-    std::ofstream ofs(directory + "/" + filename, std::ios::binary);
+void File::read_parallel(const std::vector<std::string> &filenames) {
+    std::vector<std::promise<nlohmann::json>> parsed(filenames.size());
+    std::vector<std::future<nlohmann::json>> results;
+    std::vector<ShardState> states(filenames.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+
+    // All futures are taken before any worker can set a promise
+    for (auto &promise : parsed) {
+        results.push_back(promise.get_future());
+    }
+
+    // Workers read and parse shards, the DB is only touched by this thread
+    try {
+        for (size_t n = 0; n < std::min(workers, filenames.size()); ++n) {
+            pool.emplace_back([this, &filenames, &parsed, &states, &next]() {
+                for (size_t index = next++; index < filenames.size(); index = next++) {
+                    try {
+                        nlohmann::json j;
+                        read(filenames[index], j, nullptr, &states[index]);
+                        parsed[index].set_value(std::move(j));
+                    }
+                    catch (...) {
+                        parsed[index].set_exception(std::current_exception());
+                    }
+                }
+            });
+        }
+    }
+    catch (...) {
+        // A thread could not be started: the shards no worker took yet are
+        // failed and the workers already running finish theirs
+        for (size_t index = next.exchange(filenames.size()); index < filenames.size(); ++index) {
+            parsed[index].set_exception(std::current_exception());
+        }
+        for (auto &thread : pool) {
+            thread.join();
+        }
+        throw;
+    }
+
+    size_t exept_count = 0;
+    std::exception_ptr exception;
+
+    for (size_t index = 0; index < results.size(); ++index) {
+        try {
+            nlohmann::json j = results[index].get();
+            for(auto &elem : j) {
+                insert_json(elem);
+            }
+            save_shard(filenames[index], states[index]);
+        }
+        catch (...) {
+            exept_count++;
+            exception = std::current_exception();
+        }
+    }
 
-    if (!ofs.is_open()) {
-        throw std::runtime_error(std::string("libopvault: unable to write file ") + directory + "/" + filename);
+    for (auto &thread : pool) {
+        thread.join();
     }
 
+    if (exept_count == filenames.size()) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void File::write(const std::string &filename, nlohmann::json &j) {
+    std::string prefix;
     try {
-        ofs << get_prefix(filename);
+        prefix = get_prefix(filename);
     }
     catch (...) {
         throw;
@@ -132,73 +214,128 @@ void File::write(const std::string &filename, nlohmann::json &j) {
     std::string json_string;
     json_string = j.dump();
     json_string.erase(0, 1).erase(json_string.end()-1, json_string.end());
-    ofs << json_string << "});";
 
-    ofs.close();
+    replace(filename, [&](std::ostream &os) {
+        os << prefix << json_string << "});";
+    });
 }
 
 void File::append(const std::string &filename, nlohmann::json &j) {
-    std::fstream iofs(directory + "/" + filename, std::ios::in | std::ios::out | std::ios::binary);
+    std::string json_string;
+    json_string = j.dump();
+    json_string.erase(0, 1).erase(json_string.end()-1, json_string.end());
 
-    if (iofs.is_open()) {
-        iofs.seekg(-1, std::ios::end);
-        while (iofs.get() != '}' && iofs.tellg() > 0) {
-            iofs.seekg(-2, std::ios::cur);
-        }
-        if (iofs.tellg() > 0) {
-            iofs.seekg(-1, std::ios::cur);
-            iofs.seekp(iofs.tellg());
-            iofs.seekg(-1, std::ios::cur);
-            if (iofs.get() != '{') {
-                iofs << ",";
-            }
-        } else {
-            iofs.clear();
-            try {
-                iofs << get_prefix(filename);
-            }
-            catch (...) {
-                throw;
-            }
-        }
+    MappedFile file(directory + "/" + filename);
+
+    size_t tail;
+    bool empty;
+    if (!locate_tail(file, tail, empty)) {
+        throw std::runtime_error(std::string("libopvault: invalid file format ") + directory + "/" + filename);
     }
-    else {
-        iofs.open(directory + "/" + filename, std::ios::out);
-        if (!iofs.is_open()) {
-            throw std::runtime_error(std::string("libopvault: unable to write file ") + directory + "/" + filename);
-        }
-        try {
-            iofs << get_prefix(filename);
+
+    // Copy the shard up to its closing brace and add the new elements there
+    replace(filename, [&](std::ostream &os) {
+        os.write(file.begin(), static_cast<std::streamsize>(tail));
+        if (!empty) {
+            os << ",";
         }
-        catch (...) {
-            throw;
+        os << json_string << "});";
+    });
+}
+
+void File::replace(const std::string &filename, const std::function<void(std::ostream &os)> &writer) {
+    // Write a temporary file and rename it over the shard, so readers see
+    // either the old or the new content. The data is flushed before the
+    // rename and the rename before returning, so a crash can't leave an
+    // empty or truncated shard behind
+    const std::string path = directory + "/" + filename;
+    const std::string tmp_path = path + ".tmp";
+
+    std::ostringstream os;
+    writer(os);
+    const std::string content = os.str();
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("libopvault: unable to write file ") + tmp_path);
+    }
+
+    bool ok = true;
+    for (size_t written = 0; ok && written < content.size(); ) {
+        ssize_t n = ::write(fd, content.data() + written, content.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
         }
+        ok = n > 0;
+        written += ok ? static_cast<size_t>(n) : 0;
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error(std::string("libopvault: unable to write file ") + path);
     }
-    std::string json_string;
-    json_string = j.dump();
-    json_string.erase(0, 1).erase(json_string.end()-1, json_string.end());
-    iofs << json_string << "});";
 
-    iofs.close();
+    fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 || ::fsync(fd) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error(std::string("libopvault: unable to sync directory ") + directory);
+    }
+    ::close(fd);
 }
 
-void File::append(const std::string &filename, UserItem *user_item) {
-    nlohmann::json j;
+bool File::locate_tail(const MappedFile &file, size_t &tail, bool &empty) {
+    if (file.size() == 0) {
+        return false;
+    }
 
-    update_tx(user_item);
-    // append new element to file
-    user_item->to_json(j);
-    append(filename, j);
+    // The envelope ends with "});": the closing brace is a few bytes from the
+    // end of the mapping
+    const char *brace = static_cast<const char*>(memrchr(file.begin(), '}', file.size()));
+    if (!brace) {
+        return false;
+    }
+    tail = static_cast<size_t>(brace - file.begin());
+
+    const char *prev = brace;
+    while (prev != file.begin() && isspace(static_cast<unsigned char>(*(prev-1)))) {
+        --prev;
+    }
+    if (prev == file.begin()) {
+        return false;
+    }
+    empty = *(prev-1) == '{';
+
+    return true;
 }
 
-void File::sync(const std::string filename, std::unordered_map<std::string, UserItem*> &local_map) {
+void File::sync(const std::string filename, std::unordered_map<std::string, UserItem*> &local_map, std::unordered_set<std::string> *remote_uuids) {
     nlohmann::json j;
+    ShardState state;
     bool json_is_updated = false;
+    bool exists = true;
 
-    read(filename, j);
+    try {
+        read(filename, j, nullptr, &state);
+    }
+    catch (...) {
+        // A missing shard is created if there are new local items for it
+        struct stat st;
+        if (local_map.empty() || stat((directory + "/" + filename).c_str(), &st) == 0) {
+            throw;
+        }
+        exists = false;
+        j = nlohmann::json::object();
+    }
     for(auto &elem : j) {
         // Find uuid in local map
         std::string uuid = elem["uuid"].is_string() ? elem["uuid"].get<std::string>() : "";
+        if (remote_uuids) {
+            remote_uuids->insert(uuid);
+        }
 
         auto const &found = local_map.find(uuid);
         if (found != local_map.end()) {
@@ -227,9 +364,13 @@ void File::sync(const std::string filename, std::unordered_map<std::string, User
                         throw;
                     }
                     DBGVAR(remote_updated);
+                    if (changes) {
+                        changes->resolved.push_back(uuid);
+                    }
                     if (remote_updated > found->second->updated) {
                         DBGMSG("sync local with remote item");
-                        insert_json(elem);
+                        nlohmann::json remote(elem);
+                        insert_json(remote);
                     } else {
                         DBGMSG("sync remote with local item");
                         if (!json_is_updated) {
@@ -250,67 +391,230 @@ void File::sync(const std::string filename, std::unordered_map<std::string, User
                 // Check for remote changes: remote.tx > local.tx
                 if (remote_tx > found->second->tx) {
                     DBGMSG("sync local with remote item");
-                    insert_json(elem);
+                    nlohmann::json remote(elem);
+                    insert_json(remote);
+                    if (changes) {
+                        changes->updated.push_back(uuid);
+                    }
                 }
             }
             // Remove from map
             local_map.erase(found->first);
         } else {
-            // New remote item: insert in db
-            DBGMSG("new remote item");
-            insert_json(elem);
+            // No local changes: only the local tx is needed to tell if the
+            // remote item is new or updated
+            long local_tx;
+            if (!get_tx(uuid, local_tx)) {
+                DBGMSG("new remote item");
+                nlohmann::json remote(elem);
+                insert_json(remote);
+                if (changes) {
+                    changes->added.push_back(uuid);
+                }
+            } else {
+                long remote_tx;
+                try {
+                    remote_tx = elem["tx"].is_number_integer() ? elem["tx"].get<long>() : -1;
+                }
+                catch (...) {
+                    throw;
+                }
+                if (remote_tx > local_tx) {
+                    DBGMSG("sync local with remote item");
+                    nlohmann::json remote(elem);
+                    insert_json(remote);
+                    if (changes) {
+                        changes->updated.push_back(uuid);
+                    }
+                }
+            }
         }
     }
-    if (json_is_updated) {
+
+    // New local items: elements still in the map. They go in the same
+    // write as the merged items, or are appended if nothing else changed
+    nlohmann::json j_new;
+    for (auto const &item : local_map) {
+        DBGMSG("new local item");
+        update_tx(item.second);
+        item.second->to_json(json_is_updated || !exists ? j : j_new);
+    }
+    local_map.clear();
+
+    if (json_is_updated || !exists) {
         DBGMSG("write file");
         File::write(filename, j);
+        save_shard(filename);
+    } else if (!j_new.empty()) {
+        DBGMSG("append to file");
+        File::append(filename, j_new);
+        save_shard(filename);
+    } else {
+        save_shard(filename, state);
     }
 }
 
-void File::sync(const std::vector<std::string> &filenames, std::unordered_map<std::string, UserItem *> &local_map) {
-    size_t exept_count = 0;
-
-    for (auto const &filename : filenames) {
-        try {
-            sync(filename, local_map);
+bool File::shard_changed(const std::string &filename) {
+    sqlite3_stmt *stmt = db.prepare(SQL_SELECT_SHARD);
+    sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            std::ostringstream os;
+            os << "libopvault: error reading Shards table - error code: " << rc;
+            throw std::runtime_error(os.str());
         }
-        catch (...) {
-            exept_count++;
-            if (exept_count == filenames.size()) {
-                throw;
-            }
-            continue;
+        // Never recorded: only a file that showed up since counts as changed
+        struct stat st;
+        return stat((directory + "/" + filename).c_str(), &st) == 0;
+    }
+
+    ShardState saved;
+    saved.size = sqlite3_column_int64(stmt, 0);
+    saved.mtime = sqlite3_column_int64(stmt, 1);
+    saved.hash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    sqlite3_reset(stmt);
+
+    ShardState current;
+    try {
+        MappedFile file(directory + "/" + filename);
+        if (file.size() == static_cast<size_t>(saved.size) && file.modified() == saved.mtime) {
+            return false;
         }
+        get_state(file, current);
+    }
+    catch (...) {
+        // The shard is gone: forget it
+        DBGMSG("shard removed");
+        stmt = db.prepare(SQL_DELETE_SHARD);
+        sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        return true;
     }
+
+    if (current.hash == saved.hash) {
+        // Touched but not modified
+        save_shard(filename, current);
+        return false;
+    }
+
+    return true;
 }
 
-void File::sql_exec(const char sql[]) {
-    sqlite3 *db;
-    char *zErrMsg = nullptr;
-    int rc;
+bool File::count_pending(sqlite3_stmt *stmt) {
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
+        std::ostringstream os;
+        os << "libopvault: error counting pending changes - error code: " << rc;
+        sqlite3_reset(stmt);
+        throw std::runtime_error(os.str());
+    }
+    bool pending = sqlite3_column_int64(stmt, 0) > 0;
+    sqlite3_reset(stmt);
 
-    rc = sqlite3_open(DBFILE, &db);
+    return pending;
+}
 
-    if(rc){
+bool File::select_tx(sqlite3_stmt *stmt, const std::string &uuid, long &tx) {
+    sqlite3_bind_text(stmt, 1, uuid.c_str(), -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        tx = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
         std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
+        os << "libopvault: error reading local tx - error code: " << rc;
         throw std::runtime_error(os.str());
     }
 
-    rc = sqlite3_exec(db, sql, nullptr, nullptr, &zErrMsg);
+    return rc == SQLITE_ROW;
+}
+
+void File::remove_missing(sqlite3_stmt *stmt, const char delete_sql[], const std::unordered_set<std::string> &keep) {
+    std::vector<std::string> missing;
+
+    for (;;) {
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE)
+            break;
+        if (rc != SQLITE_ROW) {
+            std::ostringstream os;
+            os << "libopvault: error reading uuids - error code: " << rc;
+            sqlite3_reset(stmt);
+            throw std::runtime_error(os.str());
+        }
+        std::string uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (keep.find(uuid) == keep.end()) {
+            missing.push_back(std::move(uuid));
+        }
+    }
+    sqlite3_reset(stmt);
+
+    for (auto const &uuid : missing) {
+        DBGMSG("remote item removed");
+        stmt = db.prepare(delete_sql);
+        sqlite3_bind_text(stmt, 1, uuid.c_str(), -1, SQLITE_STATIC);
+
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            std::ostringstream os;
+            os << "libopvault: error deleting removed item - error code: " << rc;
+            throw std::runtime_error(os.str());
+        }
+        if (changes) {
+            changes->removed.push_back(uuid);
+        }
+    }
+}
+
+void File::save_shard(const std::string &filename, const ShardState &state) {
+    sqlite3_stmt *stmt = db.prepare(SQL_REPLACE_SHARD);
 
-    if(rc != SQLITE_OK){
+    sqlite3_bind_text(stmt, 1, filename.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, state.size);
+    sqlite3_bind_int64(stmt, 3, state.mtime);
+    sqlite3_bind_text(stmt, 4, state.hash.c_str(), -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         std::ostringstream os;
-        os << "libopvault: SQL error: " << zErrMsg << " - error code: " << rc;
-        sqlite3_free(zErrMsg);
-        sqlite3_close(db);
+        os << "libopvault: error replacing data in Shards table - error code: " << rc;
         throw std::runtime_error(os.str());
     }
+}
 
-    sqlite3_free(zErrMsg);
-    sqlite3_close(db);
+void File::save_shard(const std::string &filename) {
+    ShardState state;
 
+    try {
+        MappedFile file(directory + "/" + filename);
+        get_state(file, state);
+    }
+    catch (...) {
+        throw;
+    }
+
+    save_shard(filename, state);
+}
+
+void File::get_state(const MappedFile &file, ShardState &state) {
+    byte digest[SHA256::DIGESTSIZE];
+    SHA256().CalculateDigest(digest, reinterpret_cast<const byte*>(file.begin()), file.size());
+
+    state.size = static_cast<long>(file.size());
+    state.mtime = file.modified();
+    base64_encode(digest, sizeof(digest), state.hash);
+}
+
+void File::sql_exec(const char sql[]) {
+    db.exec(sql);
 }
 
 void File::insert_json(nlohmann::json &j) {
@@ -323,6 +627,19 @@ void File::insert_json(nlohmann::json &j) {
     }
     insert_item(item);
     delete item;
+    db.row_written();
+}
+
+void File::get_long(nlohmann::json &value, long &l) {
+    if (value.is_number_integer()) {
+        l = value.get<long>();
+    }
+}
+
+void File::get_string(nlohmann::json &value, std::string &str) {
+    if (value.is_string()) {
+        str = std::move(value.get_ref<std::string&>());
+    }
 }
 
 std::string File::get_prefix(const std::string &filename) {
@@ -336,24 +653,30 @@ std::string File::get_prefix(const std::string &filename) {
 }
 
 void File::sql_update_long(const std::string &table, const std::string &col, const std::string &uuid, long val) {
+    // Only the identifiers are formatted in: the statement is cached per
+    // table and column, the values are bound
     int sz = snprintf(nullptr, 0, SQL_UPDATE_LONG,
                       table.c_str(),
-                      col.c_str(),
-                      val,
-                      uuid.c_str()) + 1;
-    char *buf;
-    buf = (char*) malloc((size_t) sz);
-    snprintf(buf, (size_t) sz, SQL_UPDATE_LONG,
+                      col.c_str()) + 1;
+    std::string sql((size_t) sz, '\0');
+    snprintf(&sql[0], (size_t) sz, SQL_UPDATE_LONG,
              table.c_str(),
-             col.c_str(),
-             val,
-             uuid.c_str());
+             col.c_str());
 
     DBGVAR(uuid);
     DBGVAR(val);
 
-    sql_exec(buf);
-    free(buf);
+    sqlite3_stmt *stmt = db.prepare(sql.c_str());
+    sqlite3_bind_int64(stmt, 1, val);
+    sqlite3_bind_text(stmt, 2, uuid.c_str(), -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        std::ostringstream os;
+        os << "libopvault: error updating " << table << " table - error code: " << rc;
+        throw std::runtime_error(os.str());
+    }
 }
 
 }
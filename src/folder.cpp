@@ -47,56 +47,52 @@ void Folder::create_table() {
 
 void Folder::insert_item(BaseItem* base_item) {
     FolderItem* folder = static_cast<FolderItem*>(base_item);
-    sqlite3 *db;
-    int rc;
+    sqlite3_stmt *stmt = db.prepare(SQL_REPLACE_FOLDER);
 
-    rc = sqlite3_open(DBFILE, &db);
+    sqlite3_bind_int64(stmt, 1, folder->created);
+    sqlite3_bind_text(stmt, 2, folder->o.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, folder->tx);
+    sqlite3_bind_int64(stmt, 4, folder->updated);
+    sqlite3_bind_text(stmt, 5, folder->uuid.c_str(), -1, SQLITE_STATIC);
 
-    if(rc){
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
+        os << "libopvault: error replacing data in Folders table - error code: " << rc;
         throw std::runtime_error(os.str());
     }
-
-    sqlite3_stmt *stmt;
-    if ((rc = sqlite3_prepare_v2(db, SQL_REPLACE_FOLDER, -1, &stmt, nullptr) != SQLITE_OK)) {
-        std::ostringstream os;
-        os << "libopvault: SQL prepare error - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
-    } else {
-        sqlite3_bind_int64(stmt, 1, folder->created);
-        sqlite3_bind_text(stmt, 2, folder->o.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 3, folder->tx);
-        sqlite3_bind_int64(stmt, 4, folder->updated);
-        sqlite3_bind_text(stmt, 5, folder->uuid.c_str(), -1, SQLITE_STATIC);
-
-        int rc = sqlite3_step(stmt);
-        if (rc != SQLITE_DONE) {
-            std::ostringstream os;
-            os << "libopvault: error replacing data in Folders table - error code: " << rc;
-            sqlite3_close(db);
-            throw std::runtime_error(os.str());
-        }
-
-        sqlite3_finalize(stmt);
-    }
-
-    sqlite3_close(db);
 }
 
 void Folder::insert_folders(std::vector<FolderItem> &folders) {
     for(auto &folder : folders) {
         if (folder.updateState) {
+            long tx;
+            bool exists = get_tx(folder.uuid, tx);
             insert_item(&folder);
             folder.updateState = false;
+            if (changes) {
+                (exists ? changes->updated : changes->added).push_back(folder.uuid);
+            }
         }
     }
 }
 
+bool Folder::get_tx(const std::string &uuid, long &tx) {
+    return select_tx(db.prepare(SQL_SELECT_FOLDER_TX), uuid, tx);
+}
+
+bool Folder::needs_sync() {
+    if (shard_changed("folders.js")) {
+        return true;
+    }
+
+    return count_pending(db.prepare(SQL_COUNT_PENDING_FOLDERS));
+}
+
 void Folder::sync(std::vector<FolderItem> &folders) {
     std::unordered_map<std::string, UserItem*> local_map;
+    std::unordered_set<std::string> keep;
 
     for (auto &folder : folders) {
         // Create a map with key uuid for local items
@@ -104,26 +100,46 @@ void Folder::sync(std::vector<FolderItem> &folders) {
     }
 
     try {
-        File::sync("folders.js", local_map);
+        File::sync("folders.js", local_map, &keep);
     }
     catch (...) {
         throw;
     }
 
-    // New local items: sync new elements still in the map
-    if (!local_map.empty()) {
-        for (auto const &folder : local_map) {
-            append("folders.js", folder.second);
+    // Folders no longer in folders.js were deleted remotely, see Band::sync
+    if (removals && !keep.empty()) {
+        for (auto const &folder : folders) {
+            keep.insert(folder.uuid);
         }
+        remove_missing(db.prepare(SQL_SELECT_FOLDER_UUIDS), SQL_DELETE_FOLDER, keep);
     }
 }
 
 BaseItem* Folder::json2item(nlohmann::json &j) {
-    return new FolderItem(j["created"].is_number_integer() ? j["created"].get<long>() : -1,
-                          j["overview"].is_string() ? j["overview"].get<std::string>() : "",
-                          j["tx"].is_number_integer() ? j["tx"].get<long>() : -1,
-                          j["updated"].is_number_integer() ? j["updated"].get<long>() : -1,
-                          j["uuid"].is_string() ? j["uuid"].get<std::string>() : "");
+    long created = -1;
+    std::string o;
+    long tx = -1;
+    long updated = -1;
+    std::string uuid;
+
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        const std::string &key = it.key();
+        nlohmann::json &value = it.value();
+
+        if (key == "uuid") {
+            get_string(value, uuid);
+        } else if (key == "overview") {
+            get_string(value, o);
+        } else if (key == "created") {
+            get_long(value, created);
+        } else if (key == "tx") {
+            get_long(value, tx);
+        } else if (key == "updated") {
+            get_long(value, updated);
+        }
+    }
+
+    return new FolderItem(created, std::move(o), tx, updated, std::move(uuid));
 }
 
 void Folder::update_tx(BaseItem* base_item) {
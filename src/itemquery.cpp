@@ -0,0 +1,120 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <sstream>
+#include <sqlite3.h>
+
+#include "const.h"
+#include "vault.h"
+
+#include "itemquery.h"
+
+namespace OPVault {
+
+ItemQuery::Cursor::~Cursor() {
+    sqlite3_finalize(stmt);
+}
+
+bool ItemQuery::Cursor::step() {
+    int rc = sqlite3_step(stmt);
+
+    if (rc == SQLITE_DONE) {
+        return false;
+    }
+    if (rc == SQLITE_BUSY) {
+        throw DatabaseBusy(rc);
+    }
+    if (rc != SQLITE_ROW) {
+        std::ostringstream os;
+        os << "libopvault: items table not present in DB - error code: " << rc;
+        throw std::runtime_error(os.str());
+    }
+
+    item = BandItem(vault);
+    vault.read_item(stmt, item);
+
+    return true;
+}
+
+ItemQuery::iterator& ItemQuery::iterator::operator++() {
+    if (!cursor->step()) {
+        cursor.reset();
+    }
+
+    return *this;
+}
+
+ItemQuery ItemQuery::where_folder(const std::string &_folder) const {
+    ItemQuery query(*this);
+    query.by_folder = true;
+    query.folder = _folder;
+
+    return query;
+}
+
+ItemQuery ItemQuery::where_category(const std::string &_category) const {
+    ItemQuery query(*this);
+    query.by_category = true;
+    query.category = _category;
+
+    return query;
+}
+
+ItemQuery::iterator ItemQuery::begin() const {
+    std::string sql(SQL_SELECT_ITEMS);
+    if (by_folder) {
+        sql += std::string(" WHERE ") + SQL_WHERE_FOLDER;
+    }
+    if (by_category) {
+        sql += std::string(by_folder ? " AND " : " WHERE ") + SQL_WHERE_CATEGORY;
+    }
+
+    // Each cursor owns its statement so several can be live at once
+    std::shared_ptr<Database> connection = vault.reader();
+    sqlite3_stmt *stmt;
+    int rc;
+    if ((rc = sqlite3_prepare_v2(connection->get(), sql.c_str(), -1, &stmt, nullptr)) != SQLITE_OK) {
+        std::ostringstream os;
+        os << "libopvault: SQL prepare error - error code: " << rc;
+        throw std::runtime_error(os.str());
+    }
+
+    int index = 1;
+    if (by_folder) {
+        sqlite3_bind_text(stmt, index++, folder.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (by_category) {
+        sqlite3_bind_text(stmt, index++, category.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    std::shared_ptr<Cursor> cursor = std::make_shared<Cursor>(vault, connection, stmt);
+    if (!cursor->step()) {
+        return end();
+    }
+
+    return iterator(cursor);
+}
+
+}
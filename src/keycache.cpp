@@ -0,0 +1,78 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "keycache.h"
+
+using namespace CryptoPP;
+
+namespace OPVault {
+
+bool KeyCache::get(const std::string &uuid, const std::string &k, SecByteBlock &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto const &found = index.find(uuid + k);
+    if (found == index.end()) {
+        return false;
+    }
+
+    // Move to the front: most recently used
+    entries.splice(entries.begin(), entries, found->second);
+    key = found->second->key;
+
+    return true;
+}
+
+void KeyCache::put(const std::string &uuid, const std::string &k, const SecByteBlock &key) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (capacity == 0) {
+        return;
+    }
+
+    std::string id(uuid + k);
+    auto const &found = index.find(id);
+    if (found != index.end()) {
+        entries.splice(entries.begin(), entries, found->second);
+        found->second->key = key;
+        return;
+    }
+
+    if (entries.size() >= capacity) {
+        index.erase(entries.back().id);
+        entries.pop_back();
+    }
+
+    entries.push_front(Entry{id, key});
+    index.insert({id, entries.begin()});
+}
+
+void KeyCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    index.clear();
+    entries.clear();
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "opdata.h"
+
+#include "keycontext.h"
+
+using namespace CryptoPP;
+
+namespace OPVault {
+
+KeyContext::KeyContext() :
+    derived_key(KEY_LENGTH),
+    overview_key(KEY_LENGTH),
+    master_key(KEY_LENGTH)
+{
+}
+
+KeyContext::~KeyContext() {
+}
+
+void KeyContext::decrypt_opdata(const std::string &encoded_opdata, const SecByteBlock &key, std::string &plaintext) const {
+    std::unique_ptr<OpdataDecryptor> decryptor;
+
+    {
+        std::lock_guard<std::mutex> lock(decryptors_mutex);
+        if (!decryptors.empty()) {
+            decryptor = std::move(decryptors.back());
+            decryptors.pop_back();
+        }
+    }
+
+    if (!decryptor) {
+        decryptor.reset(new OpdataDecryptor);
+    }
+
+    // Given back even if the value doesn't verify
+    try {
+        decryptor->set_key(key);
+        decryptor->decrypt(encoded_opdata, plaintext);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(decryptors_mutex);
+        decryptors.push_back(std::move(decryptor));
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(decryptors_mutex);
+    decryptors.push_back(std::move(decryptor));
+}
+
+}
@@ -0,0 +1,110 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "base64.h"
+#include "const.h"
+
+#include "opdata.h"
+
+using namespace CryptoPP;
+
+namespace OPVault {
+
+OpdataDecryptor::OpdataDecryptor(const SecByteBlock &key) {
+    set_key(key);
+}
+
+void OpdataDecryptor::set_key(const SecByteBlock &key) {
+    if (current_key == key) {
+        return;
+    }
+
+    hmac.SetKey(key.data()+ENC_KEY_LENGTH, MAC_KEY_LENGTH);
+    SecByteBlock iv(IV_LENGTH);
+    memset(iv.data(), 0, iv.size());
+    decryption.SetKeyWithIV(key.data(), ENC_KEY_LENGTH, iv.data(), iv.size());
+    current_key = key;
+}
+
+void OpdataDecryptor::verify(const std::string &encoded_opdata) {
+    base64_decode(encoded_opdata, opdata);
+
+    if (opdata.length() < NON_CIPHER_LENGTH || (opdata.length() - NON_CIPHER_LENGTH) % BLOCK_LENGTH) {
+        throw std::invalid_argument("libopvault: invalid opdata value");
+    }
+
+    const byte *data = reinterpret_cast<const byte *> (opdata.data());
+    size_t mac_offset = opdata.length() - MAC_LENGTH;
+
+    hmac.Update(data, mac_offset);
+    if (!hmac.Verify(data+mac_offset)) {
+        throw std::invalid_argument("libopvault: failed hash check");
+    }
+}
+
+void OpdataDecryptor::decrypt(const std::string &encoded_opdata, std::string &plaintext) {
+    verify(encoded_opdata);
+
+    const byte *data = reinterpret_cast<const byte *> (opdata.data());
+    size_t ciphertext_length = opdata.length() - NON_CIPHER_LENGTH;
+
+    if (memcmp(data, "opdata01", HEADER_LENGTH)) {
+        throw std::invalid_argument("libopvault: invalid opdata value");
+    }
+
+    size_t plaintext_length;
+    memcpy(&plaintext_length, data+HEADER_LENGTH, LENGTH_LENGTH);
+
+    if (plaintext_length > ciphertext_length) {
+        throw std::invalid_argument("libopvault: invalid opdata value");
+    }
+
+    plaintext.resize(plaintext_length);
+    if (plaintext_length == 0) {
+        return;
+    }
+
+    // The plaintext follows the random padding: only decrypt the blocks that
+    // hold it, straight into the output
+    size_t padding_length = ciphertext_length - plaintext_length;
+    size_t block = padding_length / BLOCK_LENGTH;
+    size_t offset = padding_length % BLOCK_LENGTH;
+    const byte *ciphertext = data + START_CIPHER + block * BLOCK_LENGTH;
+    byte *out = reinterpret_cast<byte *> (&plaintext[0]);
+
+    decryption.Resynchronize(block == 0 ? data+START_IV : ciphertext-BLOCK_LENGTH, IV_LENGTH);
+
+    if (offset > 0) {
+        SecByteBlock first_block(BLOCK_LENGTH);
+        decryption.ProcessData(first_block.data(), ciphertext, BLOCK_LENGTH);
+        memcpy(out, first_block.data()+offset, BLOCK_LENGTH-offset);
+        ciphertext += BLOCK_LENGTH;
+        out += BLOCK_LENGTH-offset;
+    }
+
+    decryption.ProcessData(out, ciphertext, data+START_CIPHER+ciphertext_length-ciphertext);
+}
+
+}
@@ -62,65 +62,80 @@ void Profile::create_table() {
 
 void Profile::insert_item(BaseItem* base_item) {
     ProfileItem* profile = static_cast<ProfileItem*>(base_item);
-    sqlite3 *db;
-    int rc;
-
-    rc = sqlite3_open(DBFILE, &db);
-
-    if(rc){
+    sqlite3_stmt *stmt = db.prepare(SQL_INSERT_PROFILE_ITEM);
+
+    sqlite3_bind_text(stmt, 1, profile->lastUpdatedBy.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, profile->updatedAt);
+    sqlite3_bind_text(stmt, 3, profile->profileName.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, profile->salt.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, profile->passwordHint.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, profile->masterKey.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 7, profile->iterations);
+    sqlite3_bind_text(stmt, 8, profile->uuid.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 9, profile->overviewKey.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 10, profile->createdAt);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
+        os << "libopvault: error inserting data in Profile table - error code: " << rc;
         throw std::runtime_error(os.str());
     }
+}
 
-    sqlite3_stmt *stmt;
-    if ((rc = sqlite3_prepare_v2(db, SQL_INSERT_PROFILE_ITEM, -1, &stmt, nullptr) != SQLITE_OK)) {
-        std::ostringstream os;
-        os << "libopvault: SQL prepare error - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
-    } else {
-        sqlite3_bind_text(stmt, 1, profile->lastUpdatedBy.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 2, profile->updatedAt);
-        sqlite3_bind_text(stmt, 3, profile->profileName.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, profile->salt.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, profile->passwordHint.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 6, profile->masterKey.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 7, profile->iterations);
-        sqlite3_bind_text(stmt, 8, profile->uuid.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, profile->overviewKey.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int64(stmt, 10, profile->createdAt);
-
-        int rc = sqlite3_step(stmt);
-        if (rc != SQLITE_DONE) {
-            std::ostringstream os;
-            os << "libopvault: error inserting data in Profile table - error code: " << rc;
-            sqlite3_close(db);
-            throw std::runtime_error(os.str());
+BaseItem* Profile::json2item(nlohmann::json &j) {
+    std::string lastUpdatedBy;
+    long updatedAt = -1;
+    std::string profileName;
+    std::string salt;
+    std::string passwordHint;
+    std::string masterKey;
+    unsigned int iterations = 0;
+    std::string uuid;
+    std::string overviewKey;
+    long createdAt = -1;
+
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        const std::string &key = it.key();
+        nlohmann::json &value = it.value();
+
+        if (key == "lastUpdatedBy") {
+            get_string(value, lastUpdatedBy);
+        } else if (key == "updatedAt") {
+            get_long(value, updatedAt);
+        } else if (key == "profileName") {
+            get_string(value, profileName);
+        } else if (key == "salt") {
+            get_string(value, salt);
+        } else if (key == "passwordHint") {
+            get_string(value, passwordHint);
+        } else if (key == "masterKey") {
+            get_string(value, masterKey);
+        } else if (key == "iterations") {
+            if (value.is_number_integer()) {
+                iterations = value.get<unsigned int>();
+            }
+        } else if (key == "uuid") {
+            get_string(value, uuid);
+        } else if (key == "overviewKey") {
+            get_string(value, overviewKey);
+        } else if (key == "createdAt") {
+            get_long(value, createdAt);
         }
-
-        sqlite3_finalize(stmt);
     }
 
-    sqlite3_close(db);
+    return new ProfileItem(std::move(lastUpdatedBy), updatedAt, std::move(profileName), std::move(salt), std::move(passwordHint),
+                           std::move(masterKey), iterations, std::move(uuid), std::move(overviewKey), createdAt);
 }
 
-BaseItem* Profile::json2item(nlohmann::json &j) {
-    return new ProfileItem(j["lastUpdatedBy"].is_string() ? j["lastUpdatedBy"].get<std::string>() : "",
-                           j["updatedAt"].is_number_integer() ? j["updatedAt"].get<long>() : -1,
-                           j["profileName"].is_string() ? j["profileName"].get<std::string>() : "",
-                           j["salt"].is_string() ? j["salt"].get<std::string>() : "",
-                           j["passwordHint"].is_string() ? j["passwordHint"].get<std::string>() : "",
-                           j["masterKey"].is_string() ? j["masterKey"].get<std::string>() : "",
-                           j["iterations"].is_number_integer() ? j["iterations"].get<unsigned int>() : 0,
-                           j["uuid"].is_string() ? j["uuid"].get<std::string>() : "",
-                           j["overviewKey"].is_string() ? j["overviewKey"].get<std::string>() : "",
-                           j["createdAt"].is_number_integer() ? j["createdAt"].get<long>() : -1);
+void Profile::update_tx(BaseItem* base_item) {
+    // PROFILE SYNC IS NOT SUPPORTED
 }
 
-void Profile::update_tx(BaseItem* base_item) {
+bool Profile::get_tx(const std::string &uuid, long &tx) {
     // PROFILE SYNC IS NOT SUPPORTED
+    return false;
 }
 
 }
@@ -24,11 +24,11 @@ SOFTWARE.
 */
 
 #include <cryptopp/filters.h>
-#include <cryptopp/base64.h>
 #include <cryptopp/pwdbased.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/sha3.h>
 
+#include "base64.h"
 #include "const.h"
 #include "profileitem.h"
 
@@ -36,37 +36,37 @@ using namespace CryptoPP;
 
 namespace OPVault {
 
-void ProfileItem::derive_keys(const std::string &master_password) {
+void ProfileItem::derive_keys(const std::string &master_password, KeyContext &keys) {
     std::string salt;
-    StringSource(this->salt, true, new Base64Decoder(new StringSink(salt)));
+    base64_decode(this->salt, salt);
 
     PKCS5_PBKDF2_HMAC<SHA512> pbkdf2;
-    pbkdf2.DeriveKey(derived_key, KEY_LENGTH, 0,
+    pbkdf2.DeriveKey(keys.derived_key, KEY_LENGTH, 0,
                      reinterpret_cast<const unsigned char *> (master_password.data()), master_password.length(),
                      reinterpret_cast<const unsigned char *> (salt.data()), salt.length(),
                      iterations);
 
     try {
-        verify_opdata(overviewKey, derived_key);
+        verify_opdata(overviewKey, keys.derived_key);
     }
     catch (...) {
         throw std::invalid_argument("libopvault: wrong password");
     }
 }
 
-void ProfileItem::get_profile_key(const std::string &encoded_key_opdata, SecByteBlock &profile_key) {
+void ProfileItem::get_profile_key(const std::string &encoded_key_opdata, const KeyContext &keys, SecByteBlock &profile_key) {
     std::string opdata_key;
-    decrypt_opdata(encoded_key_opdata, derived_key, opdata_key);
+    decrypt_opdata(encoded_key_opdata, keys.derived_key, opdata_key, &keys);
 
     SHA512().CalculateDigest(profile_key, reinterpret_cast<const unsigned char *> (opdata_key.data()), opdata_key.length());
 }
 
-void ProfileItem::get_master_key() {
-    get_profile_key(masterKey, master_key);
+void ProfileItem::get_master_key(KeyContext &keys) {
+    get_profile_key(masterKey, keys, keys.master_key);
 }
 
-void ProfileItem::get_overview_key() {
-    get_profile_key(overviewKey, overview_key);
+void ProfileItem::get_overview_key(KeyContext &keys) {
+    get_profile_key(overviewKey, keys, keys.overview_key);
 }
 
 }
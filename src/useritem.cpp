@@ -27,15 +27,28 @@ SOFTWARE.
 
 #include <uuid/uuid.h>
 
+#include "vault.h"
+
 #include "useritem.h"
 
 using namespace CryptoPP;
 
 namespace OPVault {
 
+UserItem::UserItem(const Vault &vault) : UserItem() {
+    keys = &vault.keys;
+}
+
+const KeyContext& UserItem::get_keys() const {
+    if (!keys) {
+        throw std::runtime_error("libopvault: item not bound to a vault");
+    }
+    return *keys;
+}
+
 void UserItem::decrypt_overview(std::string& overview) {
     if (!o.empty()) {
-        decrypt_opdata(o, overview_key, overview);
+        decrypt_opdata(o, get_keys().overview_key, overview, &get_keys());
     }
 }
 
@@ -74,7 +87,7 @@ void UserItem::set_overview(const std::string &_o) {
         o.clear();
     }
 
-    encrypt_opdata(_o, iv, overview_key, o);
+    encrypt_opdata(_o, iv, get_keys().overview_key, o);
 }
 
 }
@@ -23,269 +23,837 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <atomic>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <sqlite3.h>
 
 #include "dbg.h"
+#include "opdata.h"
 #include "vault.h"
 
 namespace OPVault {
 
-Vault::Vault(const std::string &cloud_data_dir, const std::string &local_data_dir, const std::string &master_password) {
-    if (FILE *file = fopen(std::string(local_data_dir + "opvault.db").c_str(), "r")) {
+Vault::Vault(const std::string &cloud_data_dir, const std::string &local_data_dir, const std::string &master_password, const Options &_options) :
+    options(_options),
+    key_cache(_options.key_cache_size),
+    dbfile(local_data_dir + DBFILE),
+    cloud_dir(cloud_data_dir),
+    generation(0),
+    reopen_needed(false),
+    async_pending(0),
+    subscriber_id(0)
+{
+    std::promise<void> none;
+    none.set_value();
+    sync_future = none.get_future().share();
+
+    if (FILE *file = fopen(dbfile.c_str(), "r")) {
         fclose(file);
     } else {
         DBGMSG("create DB");
+        open_db();
         create_db(cloud_data_dir);
         get_profile();
         setup_profile(master_password);
+        start_watch();
         return;
     }
 
-    Profile pro;
+    open_db();
+    upgrade_db();
+
+    Profile pro(db);
+    bool background = false;
 
     get_profile();
     pro.set_directory(cloud_data_dir);
     try {
         if (pro.read_updatedAt() > profile.updatedAt) {
             DBGMSG("Profile updated -> refreshing local DB");
-            remove(std::string(local_data_dir + "opvault.db").c_str());
+            db.close();
+            remove(dbfile.c_str());
+            open_db();
             create_db(cloud_data_dir);
         } else {
             setup_profile(master_password);
-            sync();
+            if (options.background_sync) {
+                background = true;
+            } else {
+                sync();
+            }
         }
     }
     catch (...) {
         DBGMSG("unable to read profile.js");
     }
+
+    start_watch();
+    if (background) {
+        start_sync();
+    }
 }
 
-void Vault::get_profile() {
-    sqlite3 *db;
-    int rc;
+Vault::~Vault() {
+    // Stop the background sync first: it holds write_mutex across shards,
+    // and the watcher waits for it before it can stop
+    sync_cancel.cancel();
 
-    rc = sqlite3_open(DBFILE, &db);
+    // No more file events once the watcher is gone
+    watcher.reset();
 
-    if(rc){
-        std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
+    if (sync_thread.joinable()) {
+        sync_thread.join();
     }
 
-    sqlite3_stmt *stmt;
-    if ((rc = sqlite3_prepare_v2(db, SQL_SELECT_PROFILE, -1, &stmt, nullptr)) != SQLITE_OK) {
-        std::ostringstream os;
-        os << "libopvault: SQL prepare error - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
-    } else {
-        if ((rc = sqlite3_step(stmt)) != SQLITE_ROW) {
-            std::ostringstream os;
-            os << "libopvault: profile table not present in DB - error code: " << rc;
-            sqlite3_close(db);
-            throw std::runtime_error(os.str());
+    std::unique_lock<std::mutex> lock(async_mutex);
+    async_done.wait(lock, [this]() { return async_pending == 0; });
+}
+
+void Vault::start_sync() {
+    std::shared_ptr<std::promise<void>> done = std::make_shared<std::promise<void>>();
+    sync_future = done->get_future().share();
+
+    sync_thread = std::thread([this, done]() {
+        std::exception_ptr error;
+        try {
+            sync(&sync_cancel);
         }
-        profile.lastUpdatedBy = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        profile.updatedAt = sqlite3_column_int64(stmt, 1);
-        profile.profileName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        profile.salt = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        profile.passwordHint = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        profile.masterKey = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        profile.iterations = (unsigned int) sqlite3_column_int(stmt, 6);
-        profile.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-        profile.overviewKey = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-        profile.createdAt = sqlite3_column_int64(stmt, 9);
+        catch (...) {
+            DBGMSG("background sync failed");
+            error = std::current_exception();
+        }
+
+        if (error) {
+            done->set_exception(error);
+        } else {
+            done->set_value();
+        }
+        if (options.sync_callback) {
+            options.sync_callback(generation, error);
+        }
+    });
+}
 
-        sqlite3_finalize(stmt);
+void Vault::start_watch() {
+    if (!options.watch) {
+        return;
     }
 
-    sqlite3_close(db);
+    watcher.reset(new Watcher(cloud_dir, options.watch_debounce, [this](const std::vector<std::string> &filenames) {
+        sync_files(filenames);
+    }));
 }
 
-void Vault::setup_profile(const std::string &master_password) {
-    profile.derive_keys(master_password);
-    profile.get_overview_key();
-    profile.get_master_key();
-}
+void Vault::open_db() {
+    db.open(dbfile);
 
-void Vault::get_folders(std::vector<FolderItem> &folders) const {
-    sqlite3 *db;
-    int rc;
+    if (options.wal) {
+        db.exec(SQL_PRAGMA_WAL);
+    }
+    if (options.synchronous_normal) {
+        db.exec(SQL_PRAGMA_SYNCHRONOUS_NORMAL);
+    }
+}
 
-    rc = sqlite3_open(DBFILE, &db);
+std::shared_ptr<Database> Vault::reader() const {
+    std::unique_ptr<Database> connection;
 
-    if(rc){
-        std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex);
+        if (!readers.empty()) {
+            connection = std::move(readers.back());
+            readers.pop_back();
+        }
     }
 
-    sqlite3_stmt *stmt;
-    if ((rc = sqlite3_prepare_v2(db, SQL_SELECT_FOLDERS, -1, &stmt, nullptr) != SQLITE_OK)) {
-        std::ostringstream os;
-        os << "libopvault: SQL prepare error - error code: " << rc;
-        sqlite3_close(db);
-        throw std::runtime_error(os.str());
-    } else {
-        for (;;) {
-            int rc = sqlite3_step(stmt);
-            if (rc == SQLITE_DONE)
-                break;
-            if (rc != SQLITE_ROW) {
-                std::ostringstream os;
-                os << "libopvault: folders table not present in DB - error code: " << rc;
-                sqlite3_close(db);
-                throw std::runtime_error(os.str());
-            }
-            FolderItem folder;
-            folder.created = sqlite3_column_int64(stmt, 0);
-            folder.o = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            folder.tx = sqlite3_column_int64(stmt, 2);
-            folder.updated = sqlite3_column_int64(stmt, 3);
-            folder.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-            folders.push_back(folder);
-        }
-        sqlite3_finalize(stmt);
+    if (!connection) {
+        connection.reset(new Database);
+        connection->open(dbfile);
     }
 
-    sqlite3_close(db);
+    // Given back to the pool when the last user lets go of it
+    return std::shared_ptr<Database>(connection.release(), [this](Database *released) {
+        release_reader(released);
+    });
 }
 
-void Vault::insert_folders(std::vector<FolderItem> &folders) {
-    Folder folder;
-    folder.insert_folders(folders);
-}
+void Vault::release_reader(Database *connection) const {
+    std::unique_ptr<Database> owned(connection);
 
-void Vault::get_items_query(const char query[], std::vector<BandItem> &items) const {
-    sqlite3 *db;
-    int rc;
+    std::lock_guard<std::mutex> lock(readers_mutex);
+    if (readers.size() < options.reader_connections) {
+        readers.push_back(std::move(owned));
+    }
+}
 
-    rc = sqlite3_open(DBFILE, &db);
+void Vault::upgrade_db() {
+    db.exec(SQL_CREATE_SCHEMA);
 
-    if(rc){
+    sqlite3_stmt *stmt = db.prepare(SQL_SELECT_SCHEMA_VERSION);
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
         std::ostringstream os;
-        os << "libopvault: can't open database: " << sqlite3_errmsg(db) << " - error code: " << rc;
-        sqlite3_close(db);
+        os << "libopvault: schema table not present in DB - error code: " << rc;
+        sqlite3_reset(stmt);
         throw std::runtime_error(os.str());
     }
+    int version = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
 
-    sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cout << "SQL prepare error" << std::endl;
-    } else {
-        for (;;) {
-            int rc = sqlite3_step(stmt);
-            if (rc == SQLITE_DONE)
-                break;
-            if (rc != SQLITE_ROW) {
-                std::ostringstream os;
-                os << "libopvault: items table not present in DB - error code: " << rc;
-                sqlite3_close(db);
-                throw std::runtime_error(os.str());
-            }
-            BandItem item;
-            item.created = sqlite3_column_int64(stmt, 0);
-            item.o = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            item.tx = sqlite3_column_int64(stmt, 2);
-            item.updated = sqlite3_column_int64(stmt, 3);
-            item.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-            item.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-            item.d = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            item.fave = sqlite3_column_int64(stmt, 7);
-            item.folder = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            item.hmac = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
-            item.k = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 10));
-            item.trashed = sqlite3_column_int(stmt, 11);
-            items.push_back(item);
-        }
-        sqlite3_finalize(stmt);
+    if (version >= SCHEMA_VERSION) {
+        return;
     }
 
-    sqlite3_close(db);
-}
+    DBGVAR(version);
 
-void Vault::create_db(const std::string &cloud_data_dir) {
-    Profile pro;
-    pro.set_directory(cloud_data_dir);
-    pro.create_table();
+    db.begin();
     try {
-        pro.read();
+        if (version < 1) {
+            // Indexes for the folder/category/trashed filters
+            db.exec(SQL_CREATE_ITEMS_INDEXES);
+        }
+        if (version < 2) {
+            // Cloud file states for incremental sync
+            db.exec(SQL_CREATE_SHARDS);
+        }
+        if (version < 3) {
+            // Pending local changes lookup for sync
+            db.exec(SQL_CREATE_PENDING_INDEXES);
+        }
+
+        char sql[sizeof(SQL_UPDATE_SCHEMA_VERSION) + 16];
+        snprintf(sql, sizeof(sql), SQL_UPDATE_SCHEMA_VERSION, SCHEMA_VERSION);
+        db.exec(sql);
     }
     catch (...) {
+        db.rollback();
         throw;
     }
+    db.commit();
+}
 
-    Folder folder;
-    folder.create_table();
-    try {
-        folder.read();
+void Vault::get_profile() {
+    sqlite3_stmt *stmt = db.prepare(SQL_SELECT_PROFILE);
+    int rc;
+
+    if ((rc = sqlite3_step(stmt)) != SQLITE_ROW) {
+        std::ostringstream os;
+        os << "libopvault: profile table not present in DB - error code: " << rc;
+        sqlite3_reset(stmt);
+        throw std::runtime_error(os.str());
     }
-    catch (...) {
-        throw;
+    profile.lastUpdatedBy = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    profile.updatedAt = sqlite3_column_int64(stmt, 1);
+    profile.profileName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    profile.salt = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    profile.passwordHint = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    profile.masterKey = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    profile.iterations = (unsigned int) sqlite3_column_int(stmt, 6);
+    profile.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+    profile.overviewKey = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+    profile.createdAt = sqlite3_column_int64(stmt, 9);
+
+    sqlite3_reset(stmt);
+}
+
+void Vault::setup_profile(const std::string &master_password) {
+    profile.derive_keys(master_password, keys);
+    profile.get_overview_key(keys);
+    profile.get_master_key(keys);
+}
+
+void Vault::get_folders(std::vector<FolderItem> &folders) const {
+    std::shared_ptr<Database> connection = reader();
+    get_folders_query(connection->prepare(SQL_SELECT_FOLDERS), folders);
+}
+
+void Vault::get_folders_query(sqlite3_stmt *stmt, std::vector<FolderItem> &folders) const {
+    for (;;) {
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE)
+            break;
+        if (rc == SQLITE_BUSY) {
+            sqlite3_reset(stmt);
+            throw DatabaseBusy(rc);
+        }
+        if (rc != SQLITE_ROW) {
+            std::ostringstream os;
+            os << "libopvault: folders table not present in DB - error code: " << rc;
+            sqlite3_reset(stmt);
+            throw std::runtime_error(os.str());
+        }
+        FolderItem folder(*this);
+        folder.created = sqlite3_column_int64(stmt, 0);
+        folder.o = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        folder.tx = sqlite3_column_int64(stmt, 2);
+        folder.updated = sqlite3_column_int64(stmt, 3);
+        folder.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        folders.push_back(folder);
     }
+    sqlite3_reset(stmt);
+}
 
-    Band band;
-    band.create_table();
+void Vault::insert_folders(std::vector<FolderItem> &folders) {
+    Changes changes;
+
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        Folder folder(db);
+        folder.set_changes(&changes.folders);
+
+        db.begin();
+        try {
+            folder.insert_folders(folders);
+        }
+        catch (...) {
+            db.rollback();
+            throw;
+        }
+        db.commit();
+    }
+
+    notify(changes);
+}
+
+void Vault::get_items_query(sqlite3_stmt *stmt, std::vector<BandItem> &items) const {
+    for (;;) {
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE)
+            break;
+        if (rc == SQLITE_BUSY) {
+            sqlite3_reset(stmt);
+            throw DatabaseBusy(rc);
+        }
+        if (rc != SQLITE_ROW) {
+            std::ostringstream os;
+            os << "libopvault: items table not present in DB - error code: " << rc;
+            sqlite3_reset(stmt);
+            throw std::runtime_error(os.str());
+        }
+        BandItem item(*this);
+        read_item(stmt, item);
+        items.push_back(std::move(item));
+    }
+    sqlite3_reset(stmt);
+}
+
+void Vault::read_item(sqlite3_stmt *stmt, BandItem &item) const {
+    item.created = sqlite3_column_int64(stmt, 0);
+    item.o = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    item.tx = sqlite3_column_int64(stmt, 2);
+    item.updated = sqlite3_column_int64(stmt, 3);
+    item.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    item.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    item.d = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+    item.fave = sqlite3_column_int64(stmt, 7);
+    item.folder = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+    item.hmac = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
+    item.k = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 10));
+    item.trashed = sqlite3_column_int(stmt, 11);
+    if (options.key_cache_size > 0) {
+        item.key_cache = &key_cache;
+    }
+}
+
+void Vault::create_db(const std::string &cloud_data_dir) {
+    // Import the whole cloud vault in one (or batch sized) transaction
+    db.begin(options.import_batch_size);
     try {
-        band.read();
+        db.exec(SQL_CREATE_SHARDS);
+
+        Profile pro(db);
+        pro.set_directory(cloud_data_dir);
+        pro.create_table();
+        try {
+            pro.read();
+        }
+        catch (...) {
+            throw;
+        }
+
+        Folder folder(db);
+        folder.set_directory(cloud_data_dir);
+        folder.create_table();
+        try {
+            folder.read();
+        }
+        catch (...) {
+            throw;
+        }
+
+        Band band(db);
+        band.set_directory(cloud_data_dir);
+        band.set_workers(options.ingest_workers);
+        band.create_table();
+        try {
+            band.read();
+        }
+        catch (...) {
+            throw;
+        }
     }
     catch (...) {
+        db.rollback();
         throw;
     }
+    db.commit();
+
+    upgrade_db();
 }
 
 void Vault::get_items(std::vector<BandItem> &items) const {
-    get_items_query(SQL_SELECT_ITEMS, items);
+    std::shared_ptr<Database> connection = reader();
+    get_items_query(connection->prepare(SQL_SELECT_ITEMS), items);
+}
+
+void Vault::list_items(std::vector<BandItem> &items) const {
+    std::shared_ptr<Database> connection = reader();
+    sqlite3_stmt *stmt = connection->prepare(SQL_LIST_ITEMS);
+
+    for (;;) {
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE)
+            break;
+        if (rc == SQLITE_BUSY) {
+            sqlite3_reset(stmt);
+            throw DatabaseBusy(rc);
+        }
+        if (rc != SQLITE_ROW) {
+            std::ostringstream os;
+            os << "libopvault: items table not present in DB - error code: " << rc;
+            sqlite3_reset(stmt);
+            throw std::runtime_error(os.str());
+        }
+        BandItem item(*this);
+        item.created = sqlite3_column_int64(stmt, 0);
+        item.o = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        item.tx = sqlite3_column_int64(stmt, 2);
+        item.updated = sqlite3_column_int64(stmt, 3);
+        item.uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+        item.category = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        item.fave = sqlite3_column_int64(stmt, 6);
+        item.folder = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+        item.trashed = sqlite3_column_int(stmt, 8);
+        item.vault = this;
+        item.details_loaded = false;
+        if (options.key_cache_size > 0) {
+            item.key_cache = &key_cache;
+        }
+        items.push_back(std::move(item));
+    }
+    sqlite3_reset(stmt);
 }
 
 void Vault::insert_items(std::vector<BandItem> &items) {
-    Band band;
-    band.insert_items(items);
+    Changes changes;
+
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        Band band(db);
+        band.set_changes(&changes.items);
+
+        db.begin();
+        try {
+            band.insert_items(items);
+        }
+        catch (...) {
+            db.rollback();
+            throw;
+        }
+        db.commit();
+    }
+
+    notify(changes);
 }
 
 void Vault::get_items_folder(const std::string &folder, std::vector<BandItem> &items) const {
-    int sz = snprintf(nullptr, 0, SQL_SELECT_ITEMS_FOLDER, folder.c_str()) + 1;
-    char *buf;
-    buf = (char*) malloc((size_t) sz);
-    snprintf(buf, (size_t) sz, SQL_SELECT_ITEMS_FOLDER, folder.c_str());
+    std::shared_ptr<Database> connection = reader();
+    sqlite3_stmt *stmt = connection->prepare(SQL_SELECT_ITEMS_FOLDER);
+    sqlite3_bind_text(stmt, 1, folder.c_str(), -1, SQLITE_STATIC);
 
-    get_items_query(buf, items);
-    free(buf);
+    get_items_query(stmt, items);
 }
 
 void Vault::get_items_category(const std::string &category, std::vector<BandItem> &items) const {
-    int sz = snprintf(nullptr, 0, SQL_SELECT_ITEMS_CATEGORY, category.c_str()) + 1;
-    char *buf;
-    buf = (char*) malloc((size_t) sz);
-    snprintf(buf, (size_t) sz, SQL_SELECT_ITEMS_CATEGORY, category.c_str());
+    std::shared_ptr<Database> connection = reader();
+    sqlite3_stmt *stmt = connection->prepare(SQL_SELECT_ITEMS_CATEGORY);
+    sqlite3_bind_text(stmt, 1, category.c_str(), -1, SQLITE_STATIC);
+
+    get_items_query(stmt, items);
+}
+
+void Vault::decrypt_overviews(const std::vector<BandItem> &items, std::vector<std::string> &overviews, size_t workers) const {
+    decrypt_overviews(items, overviews, workers, nullptr);
+}
+
+void Vault::decrypt_overviews(const std::vector<BandItem> &items, std::vector<std::string> &overviews, size_t workers, const CancelToken *cancel) const {
+    // Items are handed out in chunks to limit contention on the counter
+    const size_t chunk = 64;
+
+    overviews.assign(items.size(), std::string());
+
+    if (workers == 0) {
+        workers = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    workers = std::min(workers, (items.size() + chunk - 1) / chunk);
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&]() {
+        try {
+            OpdataDecryptor decryptor(keys.overview_key);
+
+            for (size_t start = next.fetch_add(chunk); start < items.size(); start = next.fetch_add(chunk)) {
+                if (cancel) {
+                    cancel->check();
+                }
+                for (size_t index = start; index < std::min(start + chunk, items.size()); ++index) {
+                    if (!items[index].o.empty()) {
+                        decryptor.decrypt(items[index].o, overviews[index]);
+                    }
+                }
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+            next = items.size();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t n = 1; n < workers; ++n) {
+        pool.emplace_back(worker);
+    }
+    worker();
+
+    for (auto &thread : pool) {
+        thread.join();
+    }
 
-    get_items_query(buf, items);
-    free(buf);
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
 }
 
 void Vault::sync() {
-    Folder folder;
+    sync(nullptr);
+}
+
+void Vault::sync(const CancelToken *cancel) {
+    Changes changes;
+
+    // Observers hear about the shards committed so far even if the sync
+    // fails or is cancelled half way
+    try {
+        std::lock_guard<std::mutex> lock(write_mutex);
+
+        if (cancel) {
+            cancel->check();
+        }
+
+        sync_folders(changes.folders);
+
+        // Only shards changed on disk or with local changes are visited
+        Band band(db);
+        band.set_directory(cloud_dir);
+        band.set_removals(options.remove_missing);
+        band.setup_filenames();
+
+        // A shard that fails doesn't stop the others, but the sync does not
+        // complete: the failed shards are reported once all were visited
+        std::ostringstream failed;
+
+        for (auto const &filename : band.filenames) {
+            // Shards already synced stay committed
+            if (cancel) {
+                cancel->check();
+            }
+
+            try {
+                sync_shard(band, filename, changes.items);
+            }
+            catch (const std::exception &e) {
+                DBGMSG("unable to sync shard");
+                failed << " " << filename << " (" << e.what() << ")";
+            }
+        }
+
+        if (!failed.str().empty()) {
+            throw std::runtime_error("libopvault: unable to sync" + failed.str());
+        }
+
+        ++generation;
+    }
+    catch (...) {
+        notify(changes);
+        throw;
+    }
+
+    notify(changes);
+}
+
+bool Vault::sync_folders(ChangeSet &changes) {
+    ChangeSet synced;
+    Folder folder(db);
+    folder.set_directory(cloud_dir);
+    folder.set_changes(&synced);
+    folder.set_removals(options.remove_missing);
+
+    if (!folder.needs_sync()) {
+        return false;
+    }
+
+    // Only folders with local changes are loaded
+    std::vector<FolderItem> folders;
+    get_folders_query(db.prepare(SQL_SELECT_PENDING_FOLDERS), folders);
+
+    db.begin();
     try {
-        std::vector<FolderItem> folders;
-        get_folders(folders);
         folder.sync(folders);
     }
     catch (...) {
+        db.rollback();
         throw;
     }
+    db.commit();
+    changes.append(synced);
 
-    Band band;
+    return true;
+}
+
+bool Vault::sync_shard(Band &band, const std::string &filename, ChangeSet &changes) {
+    if (!band.needs_sync(filename)) {
+        return false;
+    }
+    DBGVAR(filename);
+
+    // Only the items of the shard with local changes are loaded: they are
+    // the new and modified items, merged and written back in one go with
+    // their tx updates in one transaction
+    std::vector<BandItem> items;
+    sqlite3_stmt *stmt = db.prepare(SQL_SELECT_PENDING_ITEMS_SHARD);
+    band.bind_shard(stmt, filename);
+    get_items_query(stmt, items);
+
+    // Changes are only reported once committed
+    ChangeSet synced;
+    band.set_changes(&synced);
+
+    db.begin();
     try {
-        std::vector<BandItem> items;
-        get_items(items);
-        band.sync(items);
+        band.sync(filename, items);
     }
     catch (...) {
+        band.set_changes(nullptr);
+        db.rollback();
         throw;
     }
+    db.commit();
+    band.set_changes(nullptr);
+    changes.append(synced);
+
+    return true;
+}
+
+void Vault::sync_files(const std::vector<std::string> &filenames) {
+    std::vector<std::string> synced;
+    Changes changes;
+    bool profile_updated = false;
+
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+
+        Band band(db);
+        band.set_directory(cloud_dir);
+        band.set_removals(options.remove_missing);
+
+        for (auto const &filename : filenames) {
+            if (sync_cancel.cancelled()) {
+                break;
+            }
+
+            try {
+                if (filename == "folders.js") {
+                    if (sync_folders(changes.folders)) {
+                        synced.push_back(filename);
+                    }
+                } else if (filename == "profile.js") {
+                    // The profile can't be re-keyed without the master
+                    // password: a newer one is only reported
+                    Profile pro(db);
+                    pro.set_directory(cloud_dir);
+                    if (pro.read_updatedAt() > profile.updatedAt) {
+                        DBGMSG("Profile updated -> reopen needed");
+                        profile_updated = true;
+                        reopen_needed = true;
+                    }
+                } else if (sync_shard(band, filename, changes.items)) {
+                    synced.push_back(filename);
+                }
+            }
+            catch (...) {
+                DBGMSG("unable to sync changed file");
+                continue;
+            }
+        }
+
+        if (synced.empty() && !profile_updated) {
+            return;
+        }
+        if (!synced.empty()) {
+            ++generation;
+        }
+    }
+
+    if (profile_updated) {
+        synced.push_back("profile.js");
+    }
+
+    std::vector<FilesCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex);
+        for (auto const &subscriber : subscribers) {
+            callbacks.push_back(subscriber.second);
+        }
+    }
+    for (auto const &callback : callbacks) {
+        callback(generation, synced);
+    }
+
+    notify(changes);
+}
+
+void Vault::notify(const Changes &changes) {
+    if (changes.empty()) {
+        return;
+    }
+
+    std::vector<ChangesCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex);
+        for (auto const &observer : observers) {
+            callbacks.push_back(observer.second);
+        }
+    }
+    for (auto const &callback : callbacks) {
+        callback(generation, changes);
+    }
+}
+
+size_t Vault::observe(ChangesCallback callback) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    observers[++subscriber_id] = std::move(callback);
+
+    return subscriber_id;
+}
+
+size_t Vault::subscribe(FilesCallback callback) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    subscribers[++subscriber_id] = std::move(callback);
+
+    return subscriber_id;
+}
+
+void Vault::unsubscribe(size_t id) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex);
+    subscribers.erase(id);
+    observers.erase(id);
+}
+
+void Vault::async_finished() const {
+    // Notify under the lock: once it is released ~Vault may return and
+    // destroy async_done
+    std::lock_guard<std::mutex> lock(async_mutex);
+    --async_pending;
+    async_done.notify_all();
+}
+
+std::future<std::unique_ptr<Vault>> Vault::open_async(const std::string &cloud_data_dir, const std::string &local_data_dir, const std::string &master_password, const Options &options, CancelToken cancel) {
+    return Executor::shared().submit([=]() {
+        cancel.check();
+        return std::unique_ptr<Vault>(new Vault(cloud_data_dir, local_data_dir, master_password, options));
+    });
+}
+
+std::future<void> Vault::sync_async(CancelToken cancel) {
+    return run_async([this, cancel]() {
+        sync(&cancel);
+    });
+}
+
+std::future<std::vector<FolderItem>> Vault::get_folders_async(CancelToken cancel) const {
+    return run_async([this, cancel]() {
+        cancel.check();
+        std::vector<FolderItem> folders;
+        get_folders(folders);
+        return folders;
+    });
+}
+
+std::future<std::vector<BandItem>> Vault::get_items_async(CancelToken cancel) const {
+    return run_async([this, cancel]() {
+        cancel.check();
+        std::vector<BandItem> items;
+        get_items(items);
+        return items;
+    });
+}
+
+std::future<std::vector<BandItem>> Vault::get_items_folder_async(const std::string &folder, CancelToken cancel) const {
+    return run_async([this, folder, cancel]() {
+        cancel.check();
+        std::vector<BandItem> items;
+        get_items_folder(folder, items);
+        return items;
+    });
+}
+
+std::future<std::vector<BandItem>> Vault::get_items_category_async(const std::string &category, CancelToken cancel) const {
+    return run_async([this, category, cancel]() {
+        cancel.check();
+        std::vector<BandItem> items;
+        get_items_category(category, items);
+        return items;
+    });
+}
+
+std::future<std::vector<std::string>> Vault::decrypt_overviews_async(const std::vector<BandItem> &items, CancelToken cancel) const {
+    std::vector<BandItem> copy(items);
+
+    return run_async([this, copy, cancel]() {
+        std::vector<std::string> overviews;
+        decrypt_overviews(copy, overviews, 0, &cancel);
+        return overviews;
+    });
+}
+
+std::future<std::string> Vault::decrypt_overview_async(const BandItem &item, CancelToken cancel) const {
+    BandItem copy(item);
+
+    return run_async([copy, cancel]() mutable {
+        cancel.check();
+        std::string overview;
+        copy.decrypt_overview(overview);
+        return overview;
+    });
+}
+
+std::future<std::string> Vault::decrypt_data_async(const BandItem &item, CancelToken cancel) const {
+    BandItem copy(item);
+
+    return run_async([copy, cancel]() mutable {
+        cancel.check();
+        std::string data;
+        copy.decrypt_data(data);
+        return data;
+    });
 }
 
 }
@@ -0,0 +1,140 @@
+/*
+libopvault
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+Copyright (c) 2017 Marcello V. Mansueto
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "dbg.h"
+
+#include "watcher.h"
+
+namespace OPVault {
+
+Watcher::Watcher(const std::string &directory, int _debounce, Callback _callback) :
+    debounce(_debounce),
+    callback(std::move(_callback))
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        std::ostringstream os;
+        os << "libopvault: unable to watch " << directory << " - error code: " << errno;
+        throw std::runtime_error(os.str());
+    }
+
+    // Shards are replaced by rename, others tools may rewrite them in place
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0 ||
+        pipe(stop_pipe) != 0) {
+        std::ostringstream os;
+        os << "libopvault: unable to watch " << directory << " - error code: " << errno;
+        close(fd);
+        throw std::runtime_error(os.str());
+    }
+
+    thread = std::thread(&Watcher::run, this);
+}
+
+Watcher::~Watcher() {
+    char stop = 0;
+    if (write(stop_pipe[1], &stop, 1) != 1) {
+        DBGMSG("unable to stop watcher");
+    }
+    thread.join();
+
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    close(fd);
+}
+
+void Watcher::run() {
+    std::set<std::string> changed;
+    alignas(struct inotify_event) char buffer[4096];
+
+    for (;;) {
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+
+        // Every new event restarts the debounce wait
+        int rc = poll(fds, 2, changed.empty() ? -1 : debounce);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            DBGMSG("watcher poll failed");
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        if (rc == 0) {
+            std::vector<std::string> filenames(changed.begin(), changed.end());
+            changed.clear();
+            try {
+                callback(filenames);
+            }
+            catch (...) {
+                DBGMSG("watcher callback failed");
+            }
+            continue;
+        }
+
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        for (char *event_ptr = buffer; length > 0 && event_ptr < buffer + length; ) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(event_ptr);
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped: any file may have changed
+                DBGMSG("watcher queue overflow");
+                watched_all(changed);
+            } else if (event->len > 0 && watched(event->name)) {
+                changed.insert(event->name);
+            }
+            event_ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+void Watcher::watched_all(std::set<std::string> &filenames) {
+    filenames.insert("folders.js");
+    filenames.insert("profile.js");
+    for (auto const &c : std::string("0123456789ABCDEF")) {
+        filenames.insert(std::string("band_") + c + ".js");
+    }
+}
+
+bool Watcher::watched(const std::string &filename) {
+    if (filename == "folders.js" || filename == "profile.js") {
+        return true;
+    }
+
+    // band_X.js, not the temporary files the shards are written to
+    return filename.size() == 9 && filename.compare(0, 5, "band_") == 0 && filename.compare(6, 3, ".js") == 0;
+}
+
+}
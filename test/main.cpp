@@ -24,6 +24,13 @@ SOFTWARE.
 */
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
 #include <experimental/filesystem>
 #include <sqlite3.h>
 
@@ -103,6 +110,92 @@ static void get_items(const Vault &vault) {
 
 }
 
+static void list_items(const Vault &vault) {
+    vector<BandItem> items;
+
+    vault.list_items(items);
+    for(auto &item : items) {
+        cout << "Item " << item.get_uuid() << endl;
+        string str;
+        item.decrypt_overview(str);
+        cout << "Overview: " << str << endl;
+        item.decrypt_data(str);
+        cout << "Data: " << str << endl;
+    }
+}
+
+static void print_changes(unsigned long generation, const Changes &changes) {
+    cout << "Generation " << generation << endl;
+    for(auto const &uuid : changes.items.added) {
+        cout << "Item added: " << uuid << endl;
+    }
+    for(auto const &uuid : changes.items.updated) {
+        cout << "Item updated: " << uuid << endl;
+    }
+    for(auto const &uuid : changes.items.removed) {
+        cout << "Item removed: " << uuid << endl;
+    }
+    for(auto const &uuid : changes.items.resolved) {
+        cout << "Item resolved: " << uuid << endl;
+    }
+    for(auto const &uuid : changes.folders.added) {
+        cout << "Folder added: " << uuid << endl;
+    }
+    for(auto const &uuid : changes.folders.updated) {
+        cout << "Folder updated: " << uuid << endl;
+    }
+    for(auto const &uuid : changes.folders.removed) {
+        cout << "Folder removed: " << uuid << endl;
+    }
+}
+
+static void concurrent_reads(Vault &vault, vector<BandItem> &items) {
+    atomic<bool> done(false);
+    atomic<size_t> reads(0);
+    vector<thread> readers;
+
+    // Readers query and decrypt while the writer keeps inserting
+    for (int n = 0; n < 4; ++n) {
+        readers.emplace_back([&vault, &done, &reads]() {
+            do {
+                vector<FolderItem> folders;
+                vector<BandItem> read_items;
+                vault.get_folders(folders);
+                vault.get_items(read_items);
+                for(auto &item : read_items) {
+                    string str;
+                    item.decrypt_overview(str);
+                    item.decrypt_data(str);
+                }
+                ++reads;
+            } while (!done);
+        });
+    }
+
+    for (long n = 0; n < 10; ++n) {
+        items[0].set_fave(n);
+        vault.insert_items(items);
+    }
+    done = true;
+
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    cout << "Concurrent reads: " << reads << endl;
+}
+
+static void decrypt_overviews(const Vault &vault) {
+    vector<BandItem> items;
+    vector<string> overviews;
+
+    vault.get_items(items);
+    vault.decrypt_overviews(items, overviews);
+    for(size_t i = 0; i < items.size(); ++i) {
+        cout << "Item " << items[i].get_uuid() << endl;
+        cout << "Overview: " << overviews[i] << endl;
+    }
+}
+
 static void get_folders(const Vault &vault) {
     vector<FolderItem> folders;
 
@@ -137,6 +230,22 @@ static void get_items_folder(const Vault &vault) {
 
 }
 
+static void iterate_items_folder(const Vault &vault) {
+    vector<FolderItem> folders;
+
+    vault.get_folders(folders);
+
+    for(auto &folder : folders) {
+        cout << "Folder " << folder.get_uuid() << endl;
+        for(auto &item : vault.items().where_folder(folder.get_uuid())) {
+            cout << "Item " << item.get_uuid() << endl;
+            string str;
+            item.decrypt_overview(str);
+            cout << "Overview: " << str << endl;
+        }
+    }
+}
+
 static void get_items_category(const Vault &vault) {
     vector<BandItem> items;
 
@@ -174,11 +283,20 @@ int main(int argc, char *argv[])
         // GET ITEMS BY FOLDER
         get_items_folder(vault);
 
+        // ITERATE ITEMS BY FOLDER
+        iterate_items_folder(vault);
+
         // GET ITEMS BY CATEGORY
         get_items_category(vault);
 
         // GET ALL ITEMS
         get_items(vault);
+
+        // DECRYPT ALL OVERVIEWS
+        decrypt_overviews(vault);
+
+        // LIST ITEMS, DATA LOADED ON DEMAND
+        list_items(vault);
     }
 
     {
@@ -188,27 +306,30 @@ int main(int argc, char *argv[])
         vector<FolderItem> folders;
         vector<BandItem> items;
 
+        // REPORT CHANGES
+        vault.observe(print_changes);
+
         // INSERT NEW ITEMS
         items.clear();
-        BandItem item1;
+        BandItem item1(vault);
         item1.set_category("001");
         items.push_back(item1);
-        BandItem item2;
+        BandItem item2(vault);
         item2.set_data("{DATA2}");
         items.push_back(item2);
-        BandItem item3;
+        BandItem item3(vault);
         item3.set_folder("FOLDER3");
         items.push_back(item3);
-        BandItem item4;
+        BandItem item4(vault);
         item4.set_overview("{OVERVIEW4}");
         items.push_back(item4);
-        BandItem item5;
+        BandItem item5(vault);
         item5.set_fave(5000);
         items.push_back(item5);
-        BandItem item6;
+        BandItem item6(vault);
         item6.set_trashed(1);
         items.push_back(item6);
-        BandItem item7;
+        BandItem item7(vault);
         item7.set_category("099");
         item7.set_data("{DATA7}");
         item7.set_overview("{OVERVIEW7}");
@@ -216,7 +337,7 @@ int main(int argc, char *argv[])
         vault.insert_items(items);
 
         // INSERT NEW FOLDER
-        FolderItem folder;
+        FolderItem folder(vault);
         folder.set_overview("{\"title\":\"Mordor\"}");
         folders.push_back(folder);
         vault.insert_folders(folders);
@@ -249,6 +370,9 @@ int main(int argc, char *argv[])
         // CHECK MODIFIED DATA
         get_folders(vault);
         get_items(vault);
+
+        // READ FROM SEVERAL THREADS WHILE WRITING
+        concurrent_reads(vault, items);
     }
 
     std::experimental::filesystem::copy(cloud_data_dir, cloud_sync_test_data_dir, std::experimental::filesystem::copy_options::recursive);
@@ -262,6 +386,113 @@ int main(int argc, char *argv[])
         get_items(vault);
     }
 
+    {
+        // OPEN VAULT, SYNC IN BACKGROUND
+        Options options;
+        options.background_sync = true;
+        Vault vault(cloud_sync_test_data_dir, local_data_dir, master_password, options);
+
+        // LOCAL DATA IS AVAILABLE RIGHT AWAY
+        get_folders(vault);
+
+        // CHECK SYNCED DATA
+        vault.get_sync_future().get();
+        cout << "Generation: " << vault.get_generation() << endl;
+        get_items(vault);
+    }
+
+    {
+        // WATCH CLOUD FILES
+        mutex synced_mutex;
+        condition_variable synced_cv;
+        vector<string> synced;
+
+        Options options;
+        options.watch = true;
+        Vault vault(cloud_sync_test_data_dir, local_data_dir, master_password, options);
+        vault.observe(print_changes);
+        vault.subscribe([&](unsigned long generation, const vector<string> &filenames) {
+            lock_guard<mutex> lock(synced_mutex);
+            synced = filenames;
+            synced_cv.notify_all();
+        });
+
+        // CHANGE A FILE THE WAY A SYNC TOOL WOULD
+        ofstream(cloud_sync_test_data_dir + "/folders.js", ios::app) << endl;
+
+        unique_lock<mutex> lock(synced_mutex);
+        synced_cv.wait_for(lock, chrono::seconds(5), [&synced]() { return !synced.empty(); });
+        for(auto const &filename : synced) {
+            cout << "Synced: " << filename << endl;
+        }
+    }
+
+    {
+        // OPEN VAULT ASYNC
+        unique_ptr<Vault> vault = Vault::open_async(cloud_sync_test_data_dir, local_data_dir, master_password).get();
+
+        // QUERY, DECRYPT AND SYNC ASYNC
+        vector<BandItem> items = vault->get_items_async().get();
+        vector<future<string>> overviews;
+        for(auto &item : items) {
+            overviews.push_back(vault->decrypt_overview_async(item));
+        }
+        for(size_t i = 0; i < items.size(); ++i) {
+            cout << "Item " << items[i].get_uuid() << endl;
+            cout << "Overview: " << overviews[i].get() << endl;
+        }
+        cout << "Overviews: " << vault->decrypt_overviews_async(items).get().size() << endl;
+        vault->sync_async().get();
+
+        // CANCELLED OPERATION
+        CancelToken cancel;
+        cancel.cancel();
+        try {
+            vault->get_items_async(cancel).get();
+        }
+        catch (const OperationCancelled &e) {
+            cout << e.what() << endl;
+        }
+    }
+
+    {
+        // REMOVE AN ITEM FROM THE CLOUD
+        Options options;
+        options.remove_missing = true;
+        Vault vault(cloud_sync_test_data_dir, local_data_dir, master_password, options);
+
+        vector<string> removed;
+        vault.observe([&removed](unsigned long generation, const Changes &changes) {
+            removed.insert(removed.end(), changes.items.removed.begin(), changes.items.removed.end());
+        });
+
+        string uuid;
+        for (auto const &c : string("0123456789ABCDEF")) {
+            string filename = cloud_sync_test_data_dir + "/band_" + c + ".js";
+            ifstream in(filename);
+            if (!in.is_open())
+                continue;
+            string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            in.close();
+
+            size_t begin = content.find('{');
+            size_t end = content.rfind('}');
+            nlohmann::json j = nlohmann::json::parse(content.substr(begin, end - begin + 1));
+            if (j.size() < 2)
+                continue;
+            uuid = j.begin().key();
+            j.erase(uuid);
+            ofstream(filename, ios::trunc) << "ld(" << j.dump() << ");";
+            break;
+        }
+
+        vault.sync();
+        cout << "Removed: " << uuid << endl;
+        if (find(removed.begin(), removed.end(), uuid) == removed.end()) {
+            throw std::runtime_error("libopvault: removed item not reported");
+        }
+    }
+
     // RESET LOCAL DB
     remove("./opvault.db");
 